@@ -1,11 +1,15 @@
 #include "Allele.h"
 
 #include "core/graph/Node.h"
+#include "core/util/ThreadPool.hpp"
+
+#include <algorithm>
 
 namespace graphite
 {
 	Allele::Allele(const std::string& sequence) :
-		m_sequence(sequence)
+		m_sequence(sequence),
+		m_score_count_shards(1)
 	{
 	}
 
@@ -13,51 +17,75 @@ namespace graphite
 	{
 	}
 
-	void Allele::incrementScoreCount(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, int score)
+	/*
+	 * Must be called before any worker calls incrementScoreCount, there should be one shard per worker
+	 * plus one for callers that are not part of a ThreadPool.
+	 */
+	void Allele::setScoreCountShardCount(size_t shardCount)
 	{
-		// static std::mutex slock;
-		// std::lock_guard< std::mutex > lg(slock);
-		size_t alleleCountType = (size_t)scoreToAlleleCountType(score);
-		if (score < 0)
+		if (shardCount > this->m_score_count_shards.size())
 		{
-			alleleCountType = (size_t)AlleleCountType::Ambiguous;
+			this->m_score_count_shards.resize(shardCount);
 		}
-		// std::cout << "ambiguous type: " << AlleleCountTypeToString((AlleleCountType)alleleCountType) << std::endl;
-		std::unordered_map< std::string, std::vector< std::unordered_set< std::string > > >* counts = (isForwardStrand) ? &this->m_forward_counts : &this->m_reverse_counts;
+	}
 
-		std::lock_guard< std::mutex > l(m_counts_lock);
-		auto iter = counts->find(samplePtr->getName());
-		if (iter == counts->end())
+	uint64_t Allele::packScoreCountKey(uint32_t sampleIndex, uint32_t alleleCountType, bool isForwardStrand, uint32_t readIndex)
+	{
+		// sample | count type | strand | read, so sorting the keys groups them by the counts they belong to
+		return ((uint64_t)sampleIndex << 40) | ((uint64_t)alleleCountType << 33) | ((uint64_t)isForwardStrand << 32) | (uint64_t)readIndex;
+	}
+
+	void Allele::incrementScoreCount(uint32_t readIndex, uint32_t sampleIndex, bool isForwardStrand, int score)
+	{
+		size_t alleleCountType = (size_t)scoreToAlleleCountType(score);
+		if (score < 0)
 		{
-			std::vector< std::unordered_set< std::string > > sampleCounts((uint32_t)AlleleCountType::EndEnum);
-			counts->emplace(samplePtr->getName(), sampleCounts);
-			iter = counts->find(samplePtr->getName());
+			alleleCountType = (size_t)AlleleCountType::Ambiguous;
 		}
-		std::string bamID = bamAlignmentPtr->Name + std::to_string(bamAlignmentPtr->IsFirstMate());
-		auto readCounts = iter->second;
-		(*counts)[samplePtr->getName()][alleleCountType].emplace(bamID); // we are using readname so reads aren't counted more than once when we do the traceback and trackback through more than one reference node
-		// std::cout << "adding: " << AlleleCountTypeToString((AlleleCountType)alleleCountType) <<  " " << (*counts)[samplePtr->getName()][alleleCountType].size() << std::endl;
+		int threadIndex = ThreadPool::getThreadIndex();
+		size_t shardIndex = (threadIndex < 0 || (size_t)threadIndex >= this->m_score_count_shards.size() - 1) ? this->m_score_count_shards.size() - 1 : (size_t)threadIndex;
+		this->m_score_count_shards[shardIndex].m_keys.emplace_back(packScoreCountKey(sampleIndex, alleleCountType, isForwardStrand, readIndex));
 	}
 
-	std::unordered_set< std::string > Allele::getScoreCountFromAlleleCountType(const std::string& sampleName, AlleleCountType alleleCountType, bool forwardCount)
+	/*
+	 * Collapse the per thread shards into the final counts. A read is only counted once per sample, count type and strand
+	 * so reads that trace back through more than one of this allele's nodes aren't counted more than once.
+	 */
+	void Allele::mergeScoreCountShards()
 	{
-		if (forwardCount)
+		std::vector< uint64_t > keys;
+		for (auto& shard : this->m_score_count_shards)
 		{
-			auto iter = this->m_forward_counts.find(sampleName);
-			if (iter != this->m_forward_counts.end())
-			{
-				return (iter->second)[(size_t)alleleCountType];
-			}
+			keys.insert(keys.end(), shard.m_keys.begin(), shard.m_keys.end());
+			std::vector< uint64_t >().swap(shard.m_keys);
+		}
+		if (keys.empty())
+		{
+			return;
 		}
-		else
+		std::sort(keys.begin(), keys.end());
+		keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+		for (auto key : keys)
 		{
-			auto iter = this->m_reverse_counts.find(sampleName);
-			if (iter != this->m_reverse_counts.end())
+			uint32_t sampleIndex = (uint32_t)(key >> 40);
+			uint32_t alleleCountType = (uint32_t)((key >> 33) & 0x7);
+			bool isForwardStrand = ((key >> 32) & 0x1);
+			auto& counts = (isForwardStrand) ? this->m_forward_counts : this->m_reverse_counts;
+			if (counts.size() <= sampleIndex)
 			{
-				return this->m_reverse_counts[sampleName][(size_t)alleleCountType];
+				counts.resize(sampleIndex + 1, std::vector< uint32_t >((uint32_t)AlleleCountType::EndEnum, 0));
 			}
+			counts[sampleIndex][alleleCountType] += 1;
+		}
+	}
+
+	uint32_t Allele::getScoreCountFromAlleleCountType(uint32_t sampleIndex, AlleleCountType alleleCountType, bool forwardCount)
+	{
+		auto& counts = (forwardCount) ? this->m_forward_counts : this->m_reverse_counts;
+		if (sampleIndex < counts.size())
+		{
+			return counts[sampleIndex][(size_t)alleleCountType];
 		}
-		std::unordered_set< std::string > emptyValue;
-		return emptyValue;
+		return 0;
 	}
 }
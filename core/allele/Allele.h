@@ -5,12 +5,8 @@
 #include "core/sample/Sample.h"
 #include "core/util/Types.h"
 
-#include "api/BamAlignment.h"
-
 #include <memory>
-#include <mutex>
-#include <unordered_map>
-#include <unordered_set>
+#include <vector>
 
 namespace graphite
 {
@@ -25,15 +21,27 @@ namespace graphite
 		std::string getSequence() { return this->m_sequence; }
 		/* void registerNodePtr(std::shared_ptr< Node > nodePtr); */
 		/* std::shared_ptr< Node > getNodePtr(); */
-		void incrementScoreCount(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, int score);
-        std::unordered_set< std::string > getScoreCountFromAlleleCountType(const std::string& sampleName, AlleleCountType alleleCountType, bool forwardCount);
+		void setScoreCountShardCount(size_t shardCount);
+		void incrementScoreCount(uint32_t readIndex, uint32_t sampleIndex, bool isForwardStrand, int score);
+		void mergeScoreCountShards();
+		uint32_t getScoreCountFromAlleleCountType(uint32_t sampleIndex, AlleleCountType alleleCountType, bool forwardCount);
 
 	private:
+		// each worker thread appends to its own shard so counting never takes a lock.
+		// The padding keeps neighbouring shards off the same cache line.
+		struct ScoreCountShard
+		{
+			std::vector< uint64_t > m_keys;
+			char m_padding[64 - sizeof(std::vector< uint64_t >)];
+		};
+
+		static uint64_t packScoreCountKey(uint32_t sampleIndex, uint32_t alleleCountType, bool isForwardStrand, uint32_t readIndex);
+
 		std::string m_sequence;
 		/* std::shared_ptr< Node > m_node_ptr; */
-        std::unordered_map< std::string, std::vector< std::unordered_set< std::string > > > m_forward_counts; // map keyed by read SampleName then they are indexed via the AlleleCountType enum value, then add readName to the the unordered set so we are properly counting the reads
-        std::unordered_map< std::string, std::vector< std::unordered_set< std::string > > > m_reverse_counts; // map keyed by read SampleName then they are indexed via the AlleleCountType enum value, then add readName to the the unordered set so we are properly counting the reads
-		std::mutex m_counts_lock;
+		std::vector< ScoreCountShard > m_score_count_shards;
+		std::vector< std::vector< uint32_t > > m_forward_counts; // indexed by sample index then by the AlleleCountType enum value, filled in by mergeScoreCountShards
+		std::vector< std::vector< uint32_t > > m_reverse_counts; // indexed by sample index then by the AlleleCountType enum value, filled in by mergeScoreCountShards
 	};
 }
 
@@ -3,9 +3,8 @@
 namespace graphite
 {
 
-	BamAlignment::BamAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr) :
-		m_bam_alignment_ptr(bamAlignmentPtr),
-		m_sample_ptr(samplePtr)
+	BamAlignment::BamAlignment() :
+		m_read_id(0)
 	{
 	}
 
@@ -13,19 +12,27 @@ namespace graphite
 	{
 	}
 
-	std::string BamAlignment::getRead()
+	Sample::SharedPtr BamAlignment::getSamplePtr()
 	{
-		return this->m_bam_alignment_ptr->QueryBases;
+		return this->m_sample_ptr;
 	}
 
-	std::string BamAlignment::getReadName()
+	void BamAlignment::setSamplePtr(Sample::SharedPtr samplePtr)
 	{
-		return this->m_bam_alignment_ptr->Name;
+		this->m_sample_ptr = samplePtr;
 	}
 
-	Sample::SharedPtr BamAlignment::getSamplePtr()
+	/*
+	 * FNV-1a over the read name followed by the first mate flag, both mates of a pair get different ids.
+	 */
+	void BamAlignment::computeReadID()
 	{
-		return m_sample_ptr;
+		uint64_t readID = 14695981039346656037ULL;
+		for (char c : this->Name)
+		{
+			readID = (readID ^ (uint8_t)c) * 1099511628211ULL;
+		}
+		this->m_read_id = (readID ^ (uint64_t)IsFirstMate()) * 1099511628211ULL;
 	}
 
 }
@@ -1,26 +1,35 @@
 #ifndef GRAPHITE_BAMALIGNMENT_H
 #define GRAPHITE_BAMALIGNMENT_H
 
-#include "core/util/Noncopyable.hpp"
+#include "core/sample/Sample.h"
 
 #include "api/BamAlignment.h"
 
+#include <memory>
+#include <stdint.h>
+
 namespace graphite
 {
-	class BamAlignment : private Noncopyable
+	/*
+	 * A BamTools record along with the sample its read group belongs to and a 64 bit read id. The readers
+	 * fill both in while decoding so the graphs never look at the RG tag or build keys from the read name.
+	 */
+	class BamAlignment : public BamTools::BamAlignment
 	{
 	public:
 		typedef std::shared_ptr< BamAlignment > SharedPtr;
-		BamAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr);
+		BamAlignment();
 		~BamAlignment();
 
-		std::string getRead();
-		std::string getReadName();
 		Sample::SharedPtr getSamplePtr();
+		void setSamplePtr(Sample::SharedPtr samplePtr);
+		uint64_t getReadID() { return m_read_id; }
+		void computeReadID();
 
 	private:
 		Sample::SharedPtr m_sample_ptr;
-		std::shared_ptr< BamTools::BamAlignment > m_bam_alignment_ptr;
+		uint64_t m_read_id; // hash of the name and mate, equal ids still need their names compared
+
 	};
 }
 
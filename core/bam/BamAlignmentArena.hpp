@@ -0,0 +1,67 @@
+#ifndef GRAPHITE_BAMALIGNMENTARENA_HPP
+#define GRAPHITE_BAMALIGNMENTARENA_HPP
+
+#include "core/util/Noncopyable.hpp"
+
+#include "BamAlignment.h"
+
+#include <deque>
+#include <memory>
+#include <vector>
+
+namespace graphite
+{
+	/*
+	 * Owns the records of one fetch. Records are handed out as shared_ptrs that alias the arena so
+	 * accepting a record costs no allocation and every record is released together with the arena.
+	 * Once nobody but the reader holds the arena it is reset and its records (along with their
+	 * string buffers) are reused by the next fetch.
+	 */
+	class BamAlignmentArena : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< BamAlignmentArena > SharedPtr;
+		BamAlignmentArena() :
+			m_used_count(0)
+		{
+		}
+
+		// the record after the last committed one, it is handed out again until it is committed
+		BamAlignment* acquire()
+		{
+			if (this->m_used_count == this->m_alignments.size())
+			{
+				this->m_alignments.emplace_back(); // a deque so earlier records never move
+			}
+			return &this->m_alignments[this->m_used_count];
+		}
+
+		void commit() { ++this->m_used_count; }
+		void reset() { this->m_used_count = 0; }
+
+		/*
+		 * Returns an arena of arenaPtrs whose records are no longer referenced anywhere else, or a new one.
+		 * Every fetch of a cluster gets its own arena and they are all reused once the cluster's alignments are released.
+		 */
+		static SharedPtr getFreeArena(std::vector< SharedPtr >& arenaPtrs)
+		{
+			for (auto arenaPtr : arenaPtrs)
+			{
+				if (arenaPtr.use_count() == 2) // the owner's copy and this loop's copy
+				{
+					arenaPtr->reset();
+					return arenaPtr;
+				}
+			}
+			auto arenaPtr = std::make_shared< BamAlignmentArena >();
+			arenaPtrs.emplace_back(arenaPtr);
+			return arenaPtr;
+		}
+
+	private:
+		std::deque< BamAlignment > m_alignments;
+		size_t m_used_count;
+	};
+}
+
+#endif //GRAPHITE_BAMALIGNMENTARENA_HPP
@@ -0,0 +1,143 @@
+#include "BamIndex.h"
+
+#include <algorithm>
+#include <fstream>
+#include <cstring>
+
+namespace graphite
+{
+	static const uint32_t BAI_PSEUDO_BIN = 37450; // holds index metadata, not alignments
+	static const uint32_t BAI_LINEAR_SHIFT = 14; // the linear index has one entry per 16kb window
+	static const uint64_t BGZF_MAX_BLOCK_SIZE = 65536;
+
+	BamIndex::BamIndex(const std::string& bamPath) :
+		m_loaded(false)
+	{
+		// same lookup order as BamTools, file.bam.bai then file.bai
+		this->m_loaded = load(bamPath + ".bai") || load(bamPath.substr(0, bamPath.find_last_of(".")) + ".bai");
+	}
+
+	BamIndex::~BamIndex()
+	{
+	}
+
+	bool BamIndex::load(const std::string& indexPath)
+	{
+		std::ifstream inFile(indexPath, std::ios::in | std::ios::binary);
+		if (!inFile.good())
+		{
+			return false;
+		}
+		char magic[4];
+		int32_t referenceCount = 0;
+		inFile.read(magic, 4);
+		inFile.read((char*)&referenceCount, sizeof(referenceCount));
+		if (!inFile.good() || std::memcmp(magic, "BAI\1", 4) != 0 || referenceCount < 0)
+		{
+			return false;
+		}
+
+		this->m_references.clear();
+		this->m_references.resize(referenceCount);
+		for (auto& referenceIndex : this->m_references)
+		{
+			int32_t binCount = 0;
+			inFile.read((char*)&binCount, sizeof(binCount));
+			for (int32_t i = 0; i < binCount && inFile.good(); ++i)
+			{
+				uint32_t bin = 0;
+				int32_t chunkCount = 0;
+				inFile.read((char*)&bin, sizeof(bin));
+				inFile.read((char*)&chunkCount, sizeof(chunkCount));
+				std::vector< Chunk > chunks(std::max< int32_t >(chunkCount, 0));
+				for (auto& chunk : chunks)
+				{
+					inFile.read((char*)&chunk.first, sizeof(chunk.first));
+					inFile.read((char*)&chunk.second, sizeof(chunk.second));
+				}
+				if (bin != BAI_PSEUDO_BIN)
+				{
+					referenceIndex.m_bins.emplace(bin, chunks);
+				}
+			}
+			int32_t linearCount = 0;
+			inFile.read((char*)&linearCount, sizeof(linearCount));
+			referenceIndex.m_linear_offsets.resize(std::max< int32_t >(linearCount, 0));
+			if (linearCount > 0)
+			{
+				inFile.read((char*)referenceIndex.m_linear_offsets.data(), linearCount * sizeof(uint64_t));
+			}
+			if (!inFile.good())
+			{
+				this->m_references.clear();
+				return false;
+			}
+		}
+		return true;
+	}
+
+	/*
+	 * Sets fileOffset and length to the compressed bytes holding every alignment that overlaps the region,
+	 * returns false if the index has nothing for it.
+	 */
+	bool BamIndex::getFileRange(int referenceID, position startPosition, position endPosition, uint64_t& fileOffset, uint64_t& length)
+	{
+		if (!this->m_loaded || referenceID < 0 || (size_t)referenceID >= this->m_references.size() || endPosition < startPosition)
+		{
+			return false;
+		}
+		auto& referenceIndex = this->m_references[referenceID];
+		uint32_t start = (uint32_t)std::min< uint64_t >(startPosition, (1 << 29) - 1);
+		uint32_t end = (uint32_t)std::min< uint64_t >((uint64_t)endPosition + 1, 1 << 29);
+
+		// alignments before the linear index offset of the first window can't overlap the region
+		uint64_t minimumOffset = 0;
+		if (!referenceIndex.m_linear_offsets.empty())
+		{
+			minimumOffset = referenceIndex.m_linear_offsets[std::min< size_t >(start >> BAI_LINEAR_SHIFT, referenceIndex.m_linear_offsets.size() - 1)];
+		}
+
+		uint64_t rangeStart = UINT64_MAX;
+		uint64_t rangeEnd = 0;
+		std::vector< uint32_t > bins;
+		regionToBins(start, end, bins);
+		for (auto bin : bins)
+		{
+			auto iter = referenceIndex.m_bins.find(bin);
+			if (iter == referenceIndex.m_bins.end())
+			{
+				continue;
+			}
+			for (auto& chunk : iter->second)
+			{
+				if (chunk.second > minimumOffset)
+				{
+					rangeStart = std::min(rangeStart, std::max(chunk.first, minimumOffset));
+					rangeEnd = std::max(rangeEnd, chunk.second);
+				}
+			}
+		}
+		if (rangeEnd == 0)
+		{
+			return false;
+		}
+		// the upper 48 bits of a virtual offset are the block's file offset, the block the range ends in is read whole
+		fileOffset = rangeStart >> 16;
+		length = (rangeEnd >> 16) + BGZF_MAX_BLOCK_SIZE - fileOffset;
+		return true;
+	}
+
+	/*
+	 * Every bin that can hold an alignment overlapping [startPosition, endPosition), from the SAM specification.
+	 */
+	void BamIndex::regionToBins(uint32_t startPosition, uint32_t endPosition, std::vector< uint32_t >& bins)
+	{
+		--endPosition;
+		bins.emplace_back(0);
+		for (uint32_t k = 1 + (startPosition >> 26); k <= 1 + (endPosition >> 26); ++k) { bins.emplace_back(k); }
+		for (uint32_t k = 9 + (startPosition >> 23); k <= 9 + (endPosition >> 23); ++k) { bins.emplace_back(k); }
+		for (uint32_t k = 73 + (startPosition >> 20); k <= 73 + (endPosition >> 20); ++k) { bins.emplace_back(k); }
+		for (uint32_t k = 585 + (startPosition >> 17); k <= 585 + (endPosition >> 17); ++k) { bins.emplace_back(k); }
+		for (uint32_t k = 4681 + (startPosition >> 14); k <= 4681 + (endPosition >> 14); ++k) { bins.emplace_back(k); }
+	}
+}
@@ -0,0 +1,48 @@
+#ifndef GRAPHITE_BAMINDEX_H
+#define GRAPHITE_BAMINDEX_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/util/Types.h"
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+namespace graphite
+{
+	/*
+	 * Read only view of a .bai index. BamTools keeps its index private so this parses the
+	 * file again to find which compressed bytes of the bam a region lives in.
+	 */
+	class BamIndex : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< BamIndex > SharedPtr;
+		BamIndex(const std::string& bamPath);
+		~BamIndex();
+
+		bool isLoaded() { return this->m_loaded; }
+		bool getFileRange(int referenceID, position startPosition, position endPosition, uint64_t& fileOffset, uint64_t& length);
+
+	private:
+		typedef std::pair< uint64_t, uint64_t > Chunk; // virtual file offsets
+
+		struct ReferenceIndex
+		{
+			std::unordered_map< uint32_t, std::vector< Chunk > > m_bins;
+			std::vector< uint64_t > m_linear_offsets;
+		};
+
+		bool load(const std::string& indexPath);
+		static void regionToBins(uint32_t startPosition, uint32_t endPosition, std::vector< uint32_t >& bins);
+
+		bool m_loaded;
+		std::vector< ReferenceIndex > m_references;
+	};
+}
+
+#endif //GRAPHITE_BAMINDEX_H
@@ -1,78 +1,365 @@
 #include "BamReader.h"
 
+#include <algorithm>
 #include <unordered_map>
 
 namespace graphite
 {
-	BamReader::BamReader(const std::string& filename) : m_bam_path(filename)
+	BamReader::BamReader(const std::string& filename) :
+		m_sweep(false),
+		m_read_length(0),
+		m_bam_path(filename)
 	{
-		this->m_bam_reader = std::make_shared< BamTools::BamReader >();
-		if (!this->m_bam_reader->Open(filename))
+		auto handlePtr = openHandle();
+		initializeSamplePtrs(*handlePtr);
+		BamTools::BamAlignment bamtoolsAlignment;
+		if (handlePtr->m_bam_reader->GetNextAlignmentCore(bamtoolsAlignment)) // Length is a core field
 		{
-			throw "Unable to open bam file";
+			this->m_read_length = bamtoolsAlignment.Length;
 		}
-		this->m_bam_reader->LocateIndex();
-		initializeSamplePtrs();
+		releaseHandle(handlePtr);
 	}
 
 	BamReader::~BamReader()
 	{
-		this->m_bam_reader->Close();
+		for (auto handlePtr : this->m_free_handle_ptrs)
+		{
+			handlePtr->m_bam_reader->Close();
+		}
+	}
+
+	/*
+	 * Every handle opens the bam and loads the index itself, BamTools binds an index to the reader that loaded it.
+	 */
+	std::shared_ptr< BamReader::ReaderHandle > BamReader::openHandle()
+	{
+		auto handlePtr = std::make_shared< ReaderHandle >();
+		handlePtr->m_bam_reader = std::make_shared< BamTools::BamReader >();
+		if (!handlePtr->m_bam_reader->Open(this->m_bam_path))
+		{
+			throw "Unable to open bam file";
+		}
+		handlePtr->m_bam_reader->LocateIndex();
+		handlePtr->m_window_start = 0;
+		handlePtr->m_window_end = 0;
+		handlePtr->m_sweep_reference_id = -1;
+		handlePtr->m_sweep_position = 0;
+		handlePtr->m_sweep_alignment_loaded = false;
+		return handlePtr;
 	}
 
-	void BamReader::initializeSamplePtrs()
+	/*
+	 * Takes a free handle out of the pool, preferring one whose window already reaches startPosition so
+	 * consecutive clusters keep landing on the same handle.
+	 */
+	std::shared_ptr< BamReader::ReaderHandle > BamReader::acquireHandle(const std::string& referenceID, position startPosition)
 	{
-		auto readGroups = this->m_bam_reader->GetHeader().ReadGroups;
+		{
+			std::lock_guard< std::mutex > lock(this->m_handle_lock);
+			if (!this->m_free_handle_ptrs.empty())
+			{
+				auto iter = std::find_if(this->m_free_handle_ptrs.begin(), this->m_free_handle_ptrs.end(), [&referenceID, startPosition](const std::shared_ptr< ReaderHandle >& handlePtr)
+										 {
+											 return handlePtr->m_window_reference_id == referenceID && handlePtr->m_window_start <= startPosition && startPosition <= handlePtr->m_window_end;
+										 });
+				if (iter == this->m_free_handle_ptrs.end())
+				{
+					iter = this->m_free_handle_ptrs.end() - 1;
+				}
+				auto handlePtr = *iter;
+				this->m_free_handle_ptrs.erase(iter);
+				return handlePtr;
+			}
+		}
+		return openHandle(); // every handle is busy
+	}
+
+	void BamReader::releaseHandle(std::shared_ptr< ReaderHandle > handlePtr)
+	{
+		std::lock_guard< std::mutex > lock(this->m_handle_lock);
+		this->m_free_handle_ptrs.emplace_back(handlePtr);
+	}
+
+	void BamReader::initializeSamplePtrs(ReaderHandle& handle)
+	{
+		auto readGroups = handle.m_bam_reader->GetHeader().ReadGroups;
 		auto iter = readGroups.Begin();
 		for (; iter != readGroups.End(); ++iter)
 		{
 			auto samplePtr = std::make_shared< Sample >((*iter).Sample, (*iter).ID, this->m_bam_path);
-			this->m_sample_ptrs.emplace(samplePtr);
+			this->m_sample_ptrs.emplace_back(samplePtr);
+			this->m_read_group_sample_ptrs.emplace((*iter).ID, samplePtr);
+		}
+	}
+
+	/*
+	 * Resolves the record's read group to its sample and sets its read id, returns false for reads without a read group from the header.
+	 */
+	bool BamReader::setSamplePtr(ReaderHandle& handle, BamAlignment& bamAlignment)
+	{
+		if (!bamAlignment.GetTag("RG", handle.m_read_group))
+		{
+			return false;
+		}
+		auto iter = this->m_read_group_sample_ptrs.find(handle.m_read_group);
+		if (iter == this->m_read_group_sample_ptrs.end())
+		{
+			return false;
 		}
+		bamAlignment.setSamplePtr(iter->second);
+		bamAlignment.computeReadID();
+		return true;
 	}
 
-	std::unordered_set< Sample::SharedPtr > BamReader::getSamplePtrs()
+	std::vector< Sample::SharedPtr > BamReader::getSamplePtrs()
 	{
 		return this->m_sample_ptrs;
 	}
 
 	/*
-	 * Concat new bamAlignments to the passed in list, bamAlignmentPtrs.
+	 * Prefetching needs the .bai to find the blocks a region lives in, without one it stays off.
+	 */
+	void BamReader::enablePrefetch()
+	{
+		this->m_bam_index_ptr = std::make_shared< BamIndex >(this->m_bam_path);
+		if (this->m_bam_index_ptr->isLoaded())
+		{
+			this->m_prefetcher_ptr = std::make_shared< FilePrefetcher >(this->m_bam_path);
+		}
+	}
+
+	/*
+	 * For inputs with variants all along the genome, reading the gaps between clusters is cheaper than seeking over them.
+	 */
+	void BamReader::enableSweep()
+	{
+		this->m_sweep = true;
+	}
+
+	/*
+	 * Starts pulling the bgzf blocks of the region into memory in the background and returns right away.
+	 */
+	void BamReader::prefetchRegion(Region::SharedPtr regionPtr)
+	{
+		if (this->m_prefetcher_ptr == nullptr)
+		{
+			return;
+		}
+		auto handlePtr = acquireHandle(regionPtr->getReferenceID(), regionPtr->getStartPosition());
+		int refID = handlePtr->m_bam_reader->GetReferenceID(regionPtr->getReferenceID());
+		releaseHandle(handlePtr);
+		uint64_t fileOffset = 0;
+		uint64_t length = 0;
+		if (this->m_bam_index_ptr->getFileRange(refID, regionPtr->getStartPosition(), regionPtr->getEndPosition(), fileOffset, length))
+		{
+			this->m_prefetcher_ptr->prefetch(fileOffset, length);
+		}
+	}
+
+	/*
+	 * Concat new bamAlignments to the passed in list, bamAlignmentPtrs. Safe to call from several threads,
+	 * each call works on its own handle.
+	 * Consecutive clusters overlap so reads are served from a window that only decodes the part of
+	 * the region it hasn't seen yet. The window only holds non duplicate reads, other requests go to the index.
 	 */
 	void BamReader::fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads)
 	{
-		int refID = this->m_bam_reader->GetReferenceID(regionPtr->getReferenceID());
-		this->m_bam_reader->SetRegion(refID, regionPtr->getStartPosition(), refID, regionPtr->getEndPosition());
-		BamTools::BamAlignment* bamtoolsAlignmentPtr = new BamTools::BamAlignment();
 		position startPosition = regionPtr->getStartPosition();
 		position endPosition = regionPtr->getEndPosition();
-		while (this->m_bam_reader->GetNextAlignment(*bamtoolsAlignmentPtr))
+		auto handlePtr = acquireHandle(regionPtr->getReferenceID(), startPosition);
+		ReaderHandle& handle = *handlePtr;
+		if (unmappedOnly || includeDuplicateReads)
+		{
+			fetchBamAlignmentPtrsFromIndex(handle, bamAlignmentPtrs, regionPtr, unmappedOnly, includeDuplicateReads);
+			releaseHandle(handlePtr);
+			return;
+		}
+
+		// start over when the region isn't contiguous with the window, reading the gap would cost more than a seek
+		if (regionPtr->getReferenceID() != handle.m_window_reference_id || startPosition < handle.m_window_start || handle.m_window_end < startPosition)
+		{
+			handle.m_window_alignment_ptrs.clear();
+			handle.m_window_reference_id = regionPtr->getReferenceID();
+			handle.m_window_start = startPosition;
+			handle.m_window_end = startPosition;
+		}
+		if (handle.m_window_end < endPosition)
+		{
+			extendWindow(handle, endPosition);
+		}
+
+		auto iter = std::upper_bound(handle.m_window_alignment_ptrs.begin(), handle.m_window_alignment_ptrs.end(), startPosition, [](position pos, const std::shared_ptr< BamAlignment >& bamAlignmentPtr) { return pos < (position)bamAlignmentPtr->Position; });
+		for (; iter != handle.m_window_alignment_ptrs.end() && (position)(*iter)->Position < endPosition; ++iter)
+		{
+			if (((int64_t)(*iter)->Position + (*iter)->Length) < (int64_t)endPosition)
+			{
+				bamAlignmentPtrs.emplace_back(*iter);
+			}
+		}
+		releaseHandle(handlePtr);
+	}
+
+	/*
+	 * Decodes the reads starting in [m_window_end, endPosition) into the handle's window.
+	 */
+	void BamReader::extendWindow(ReaderHandle& handle, position endPosition)
+	{
+		position windowEnd = handle.m_window_end;
+		handle.m_window_end = endPosition;
+		int refID = handle.m_bam_reader->GetReferenceID(handle.m_window_reference_id);
+		if (refID < 0)
+		{
+			return;
+		}
+		auto arenaPtr = BamAlignmentArena::getFreeArena(handle.m_arena_ptrs);
+		if (this->m_sweep)
+		{
+			sweepWindow(handle, refID, windowEnd, endPosition, arenaPtr);
+			return;
+		}
+		if (!handle.m_bam_reader->SetRegion(refID, windowEnd, refID, endPosition))
+		{
+			return;
+		}
+		BamAlignment* bamtoolsAlignmentPtr = arenaPtr->acquire();
+		while (handle.m_bam_reader->GetNextAlignmentCore(*bamtoolsAlignmentPtr))
+		{
+			// reads that start before windowEnd overlap the region but are already in the window
+			if (bamtoolsAlignmentPtr->Position < 0 || (position)bamtoolsAlignmentPtr->Position < windowEnd || endPosition <= (position)bamtoolsAlignmentPtr->Position || bamtoolsAlignmentPtr->IsDuplicate())
+			{
+				continue;
+			}
+			bamtoolsAlignmentPtr->BuildCharData();
+			if (!setSamplePtr(handle, *bamtoolsAlignmentPtr))
+			{
+				continue;
+			}
+			handle.m_window_alignment_ptrs.emplace_back(std::shared_ptr< BamAlignment >(arenaPtr, bamtoolsAlignmentPtr));
+			arenaPtr->commit();
+			bamtoolsAlignmentPtr = arenaPtr->acquire();
+		}
+	}
+
+	/*
+	 * Sweep mode's extendWindow, continues reading where the previous extension stopped and only
+	 * seeks when moving to another chromosome or when the window went back behind the stream.
+	 */
+	void BamReader::sweepWindow(ReaderHandle& handle, int refID, position windowEnd, position endPosition, BamAlignmentArena::SharedPtr arenaPtr)
+	{
+		if (handle.m_sweep_alignment_loaded && handle.m_sweep_alignment.RefID == refID && handle.m_sweep_reference_id < refID)
+		{
+			// the stream just crossed into this chromosome so none of its reads have been consumed
+			handle.m_sweep_reference_id = refID;
+			handle.m_sweep_position = 0;
+		}
+		if (handle.m_sweep_reference_id != refID || windowEnd < handle.m_sweep_position)
+		{
+			handle.m_sweep_alignment_loaded = false;
+			handle.m_sweep_reference_id = refID;
+			handle.m_sweep_position = windowEnd;
+			if (!handle.m_bam_reader->Jump(refID, windowEnd))
+			{
+				handle.m_sweep_reference_id = -1;
+				return;
+			}
+		}
+		while (true)
+		{
+			if (!handle.m_sweep_alignment_loaded)
+			{
+				if (!handle.m_bam_reader->GetNextAlignmentCore(handle.m_sweep_alignment))
+				{
+					break;
+				}
+				handle.m_sweep_alignment_loaded = true;
+			}
+			// leave the first read past the window loaded for the next extension
+			if (handle.m_sweep_alignment.RefID != refID || (handle.m_sweep_alignment.Position >= 0 && endPosition <= (position)handle.m_sweep_alignment.Position))
+			{
+				break;
+			}
+			handle.m_sweep_alignment_loaded = false;
+			if (handle.m_sweep_alignment.Position < 0 || (position)handle.m_sweep_alignment.Position < windowEnd || handle.m_sweep_alignment.IsDuplicate())
+			{
+				continue; // the gap between clusters is read but never decoded
+			}
+			BamAlignment* bamtoolsAlignmentPtr = arenaPtr->acquire();
+			static_cast< BamTools::BamAlignment& >(*bamtoolsAlignmentPtr) = handle.m_sweep_alignment; // reuses the arena record's buffers
+			bamtoolsAlignmentPtr->BuildCharData();
+			if (!setSamplePtr(handle, *bamtoolsAlignmentPtr))
+			{
+				continue;
+			}
+			handle.m_window_alignment_ptrs.emplace_back(std::shared_ptr< BamAlignment >(arenaPtr, bamtoolsAlignmentPtr));
+			arenaPtr->commit();
+		}
+		handle.m_sweep_position = std::max(handle.m_sweep_position, endPosition);
+	}
+
+	/*
+	 * Drops the windows' reads that start at or before evictionPosition, called as the clusters move along the chromosome.
+	 * Handles that are fetching right now are skipped, they are evicted by a later call.
+	 */
+	void BamReader::evictAlignmentsBefore(const std::string& referenceID, position evictionPosition)
+	{
+		std::lock_guard< std::mutex > lock(this->m_handle_lock);
+		for (auto handlePtr : this->m_free_handle_ptrs)
+		{
+			evictHandleAlignmentsBefore(*handlePtr, referenceID, evictionPosition);
+		}
+	}
+
+	void BamReader::evictHandleAlignmentsBefore(ReaderHandle& handle, const std::string& referenceID, position evictionPosition)
+	{
+		if (referenceID != handle.m_window_reference_id || evictionPosition < handle.m_window_start)
+		{
+			return;
+		}
+		while (!handle.m_window_alignment_ptrs.empty() && (position)handle.m_window_alignment_ptrs.front()->Position <= evictionPosition)
+		{
+			handle.m_window_alignment_ptrs.pop_front();
+		}
+		handle.m_window_start = evictionPosition;
+		handle.m_window_end = std::max(handle.m_window_end, evictionPosition);
+	}
+
+	void BamReader::fetchBamAlignmentPtrsFromIndex(ReaderHandle& handle, std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads)
+	{
+		// moves the stream
+		handle.m_sweep_reference_id = -1;
+		handle.m_sweep_alignment_loaded = false;
+		int refID = handle.m_bam_reader->GetReferenceID(regionPtr->getReferenceID());
+		handle.m_bam_reader->SetRegion(refID, regionPtr->getStartPosition(), refID, regionPtr->getEndPosition());
+		auto arenaPtr = BamAlignmentArena::getFreeArena(handle.m_arena_ptrs);
+		BamAlignment* bamtoolsAlignmentPtr = arenaPtr->acquire();
+		position startPosition = regionPtr->getStartPosition();
+		position endPosition = regionPtr->getEndPosition();
+		// filter on the core fields and only decode the name, bases, qualities and tags of records that are kept
+		while (handle.m_bam_reader->GetNextAlignmentCore(*bamtoolsAlignmentPtr))
 		{
 			bool isInRegion = (startPosition < bamtoolsAlignmentPtr->Position && (bamtoolsAlignmentPtr->Position + bamtoolsAlignmentPtr->Length) < endPosition);
 			if ((bamtoolsAlignmentPtr->IsDuplicate() && !includeDuplicateReads) ||
 				(unmappedOnly && bamtoolsAlignmentPtr->IsMapped()) || !isInRegion)
 			{
-				delete bamtoolsAlignmentPtr; // delete the ptr if the ptr isn't added to the alignmentPtrs
+				continue; // a rejected record is overwritten by the next one
 			}
-			else
+			bamtoolsAlignmentPtr->BuildCharData();
+			if (!setSamplePtr(handle, *bamtoolsAlignmentPtr))
 			{
-				std::shared_ptr< BamTools::BamAlignment > bamAlignmentSharedPtr(bamtoolsAlignmentPtr, [](BamTools::BamAlignment* btPtr)
-																				{
-																					delete btPtr;
-																				});
-				bamAlignmentPtrs.emplace_back(bamAlignmentSharedPtr);
+				continue;
 			}
-			bamtoolsAlignmentPtr = new BamTools::BamAlignment();
+			// shares the arena's ownership instead of allocating one per record
+			bamAlignmentPtrs.emplace_back(std::shared_ptr< BamAlignment >(arenaPtr, bamtoolsAlignmentPtr));
+			arenaPtr->commit();
+			bamtoolsAlignmentPtr = arenaPtr->acquire();
 		}
-		delete bamtoolsAlignmentPtr; // the last bamtoolsAlignmentPtr is always when GetNextAlignment returned false so we can delete it
 	}
 
+	/*
+	 * Length of the first read in the bam, read when the bam is opened.
+	 */
 	uint32_t BamReader::getReadLength()
 	{
-		BamTools::BamAlignment* bamtoolsAlignmentPtr = new BamTools::BamAlignment();
-		this->m_bam_reader->GetNextAlignment(*bamtoolsAlignmentPtr);
-		uint32_t readLength = bamtoolsAlignmentPtr->Length;
-		delete bamtoolsAlignmentPtr;
-		return readLength;
+		return this->m_read_length;
 	}
 }
@@ -1,38 +1,84 @@
 #ifndef GRAPHITE_BAMREADER_H
 #define GRAPHITE_BAMREADER_H
 
-#include "core/util/Noncopyable.hpp"
-#include "core/region/Region.h"
-#include "core/sample/Sample.h"
+#include "core/util/FilePrefetcher.h"
+#include "IAlignmentReader.h"
+#include "BamIndex.h"
+#include "BamAlignmentArena.hpp"
 
 #include "api/BamReader.h"
 #include "api/BamAlignment.h"
 #include "api/BamAux.h"
 
+#include <deque>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 
 namespace graphite
 {
-    typedef BamTools::BamAlignment BamAlignment;
-	class BamReader : private Noncopyable
+	class BamReader : public IAlignmentReader
 	{
 	public:
 		typedef std::shared_ptr< BamReader > SharedPtr;
 		BamReader(const std::string& filename);
 		~BamReader();
 
-		void fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads);
+		void enablePrefetch() override;
+		void enableSweep() override;
+		void prefetchRegion(Region::SharedPtr regionPtr) override;
+		void fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads) override;
+		void evictAlignmentsBefore(const std::string& referenceID, position evictionPosition) override;
 
-        std::unordered_set< Sample::SharedPtr > getSamplePtrs();
-		uint32_t getReadLength();
+        std::vector< Sample::SharedPtr > getSamplePtrs() override;
+		uint32_t getReadLength() override;
 
 	private:
-		void initializeSamplePtrs();
-		std::shared_ptr< BamTools::BamReader > m_bam_reader;
-		std::unordered_set< Sample::SharedPtr > m_sample_ptrs;
+		/*
+		 * An independent BamTools reader with its own file position, read window and sweep stream.
+		 * A handle is only used by one fetch at a time.
+		 */
+		struct ReaderHandle
+		{
+			std::shared_ptr< BamTools::BamReader > m_bam_reader;
+			std::vector< BamAlignmentArena::SharedPtr > m_arena_ptrs;
+			// decoded non duplicate reads of one chromosome sorted by position, every read starting in [m_window_start, m_window_end) is in the window
+			std::deque< std::shared_ptr< BamAlignment > > m_window_alignment_ptrs;
+			std::string m_window_reference_id;
+			position m_window_start;
+			position m_window_end;
+			// sweep mode reads each chromosome front to back instead of seeking to every cluster.
+			// Every read on m_sweep_reference_id starting at or after m_sweep_position hasn't been read yet,
+			// m_sweep_alignment is the next one when m_sweep_alignment_loaded is set
+			int m_sweep_reference_id;
+			position m_sweep_position;
+			BamTools::BamAlignment m_sweep_alignment;
+			bool m_sweep_alignment_loaded;
+			std::string m_read_group; // the RG tag of the record being decoded
+		};
+
+		void initializeSamplePtrs(ReaderHandle& handle);
+		bool setSamplePtr(ReaderHandle& handle, BamAlignment& bamAlignment);
+		std::shared_ptr< ReaderHandle > openHandle();
+		std::shared_ptr< ReaderHandle > acquireHandle(const std::string& referenceID, position startPosition);
+		void releaseHandle(std::shared_ptr< ReaderHandle > handlePtr);
+		void fetchBamAlignmentPtrsFromIndex(ReaderHandle& handle, std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads);
+		void extendWindow(ReaderHandle& handle, position endPosition);
+		void sweepWindow(ReaderHandle& handle, int refID, position windowEnd, position endPosition, BamAlignmentArena::SharedPtr arenaPtr);
+		static void evictHandleAlignmentsBefore(ReaderHandle& handle, const std::string& referenceID, position evictionPosition);
+
+		// handles that aren't fetching right now, a fetch opens another handle when they are all busy
+		std::vector< std::shared_ptr< ReaderHandle > > m_free_handle_ptrs;
+		std::mutex m_handle_lock;
+		BamIndex::SharedPtr m_bam_index_ptr;
+		FilePrefetcher::SharedPtr m_prefetcher_ptr;
+		bool m_sweep;
+		uint32_t m_read_length;
+		std::vector< Sample::SharedPtr > m_sample_ptrs;
+		std::unordered_map< std::string, Sample::SharedPtr > m_read_group_sample_ptrs; // filled in the constructor, only read afterwards
 		std::unordered_set< std::string > m_sample_names;
 		std::string m_bam_path;
 	};
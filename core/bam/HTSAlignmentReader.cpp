@@ -0,0 +1,253 @@
+#include "HTSAlignmentReader.h"
+
+#include "core/util/Utility.h"
+
+namespace graphite
+{
+	HTSAlignmentReader::HTSAlignmentReader(const std::string& path, const std::string& referencePath, uint32_t decompressionThreadCount) :
+		m_path(path),
+		m_reference_path(referencePath),
+		m_header_ptr(nullptr),
+		m_index_ptr(nullptr),
+		m_read_length(0)
+	{
+		this->m_thread_pool.pool = (decompressionThreadCount > 0) ? hts_tpool_init(decompressionThreadCount) : nullptr;
+		this->m_thread_pool.qsize = 0;
+		auto handlePtr = openHandle();
+		this->m_header_ptr = sam_hdr_read(handlePtr->m_file_ptr);
+		if (this->m_header_ptr == nullptr)
+		{
+			throw "Unable to read the alignment file header";
+		}
+		this->m_index_ptr = sam_index_load(handlePtr->m_file_ptr, path.c_str());
+		if (this->m_index_ptr == nullptr)
+		{
+			throw "Unable to open the alignment file index";
+		}
+		initializeSamplePtrs();
+		if (sam_read1(handlePtr->m_file_ptr, this->m_header_ptr, handlePtr->m_record_ptr) >= 0)
+		{
+			this->m_read_length = handlePtr->m_record_ptr->core.l_qseq;
+		}
+		releaseHandle(handlePtr);
+	}
+
+	HTSAlignmentReader::~HTSAlignmentReader()
+	{
+		for (auto& handlePtr : this->m_handle_ptrs)
+		{
+			bam_destroy1(handlePtr->m_record_ptr);
+			hts_close(handlePtr->m_file_ptr);
+		}
+		if (this->m_index_ptr != nullptr)
+		{
+			hts_idx_destroy(this->m_index_ptr);
+		}
+		if (this->m_header_ptr != nullptr)
+		{
+			bam_hdr_destroy(this->m_header_ptr);
+		}
+		if (this->m_thread_pool.pool != nullptr)
+		{
+			hts_tpool_destroy(this->m_thread_pool.pool);
+		}
+	}
+
+	HTSAlignmentReader::ReaderHandle* HTSAlignmentReader::openHandle()
+	{
+		htsFile* filePtr = hts_open(this->m_path.c_str(), "r");
+		if (filePtr == nullptr)
+		{
+			throw "Unable to open alignment file";
+		}
+		if (filePtr->format.format == cram && hts_set_fai_filename(filePtr, this->m_reference_path.c_str()) != 0)
+		{
+			hts_close(filePtr);
+			throw "Unable to set the cram reference";
+		}
+		if (this->m_thread_pool.pool != nullptr)
+		{
+			hts_set_opt(filePtr, HTS_OPT_THREAD_POOL, &this->m_thread_pool);
+		}
+		std::unique_ptr< ReaderHandle > handlePtr(new ReaderHandle());
+		handlePtr->m_file_ptr = filePtr;
+		handlePtr->m_record_ptr = bam_init1();
+		ReaderHandle* rawHandlePtr = handlePtr.get();
+		std::lock_guard< std::mutex > lock(this->m_handle_lock);
+		this->m_handle_ptrs.emplace_back(std::move(handlePtr));
+		return rawHandlePtr;
+	}
+
+	HTSAlignmentReader::ReaderHandle* HTSAlignmentReader::acquireHandle()
+	{
+		{
+			std::lock_guard< std::mutex > lock(this->m_handle_lock);
+			if (!this->m_free_handle_ptrs.empty())
+			{
+				auto handlePtr = this->m_free_handle_ptrs.back();
+				this->m_free_handle_ptrs.pop_back();
+				return handlePtr;
+			}
+		}
+		return openHandle(); // every handle is busy
+	}
+
+	void HTSAlignmentReader::releaseHandle(ReaderHandle* handlePtr)
+	{
+		std::lock_guard< std::mutex > lock(this->m_handle_lock);
+		this->m_free_handle_ptrs.emplace_back(handlePtr);
+	}
+
+	void HTSAlignmentReader::initializeSamplePtrs()
+	{
+		std::vector< std::string > headerLines;
+		split(std::string(this->m_header_ptr->text, this->m_header_ptr->l_text), '\n', headerLines);
+		for (auto& headerLine : headerLines)
+		{
+			if (headerLine.compare(0, 3, "@RG") != 0)
+			{
+				continue;
+			}
+			std::string readGroupID;
+			std::string sampleName;
+			std::vector< std::string > fields;
+			split(headerLine, '\t', fields);
+			for (auto& field : fields)
+			{
+				if (field.compare(0, 3, "ID:") == 0)
+				{
+					readGroupID = field.substr(3);
+				}
+				else if (field.compare(0, 3, "SM:") == 0)
+				{
+					sampleName = field.substr(3);
+				}
+			}
+			auto samplePtr = std::make_shared< Sample >(sampleName, readGroupID, this->m_path);
+			this->m_sample_ptrs.emplace_back(samplePtr);
+			this->m_read_group_sample_ptrs.emplace(readGroupID, samplePtr);
+		}
+	}
+
+	/*
+	 * The sample of the handle's current record's read group, nullptr when the record has no read group from the header.
+	 */
+	Sample::SharedPtr HTSAlignmentReader::getRecordSamplePtr(ReaderHandle* handlePtr)
+	{
+		uint8_t* readGroupPtr = bam_aux_get(handlePtr->m_record_ptr, "RG");
+		char* readGroup = (readGroupPtr != nullptr) ? bam_aux2Z(readGroupPtr) : nullptr;
+		if (readGroup == nullptr)
+		{
+			return nullptr;
+		}
+		handlePtr->m_read_group.assign(readGroup);
+		auto iter = this->m_read_group_sample_ptrs.find(handlePtr->m_read_group);
+		return (iter != this->m_read_group_sample_ptrs.end()) ? iter->second : nullptr;
+	}
+
+	std::vector< Sample::SharedPtr > HTSAlignmentReader::getSamplePtrs()
+	{
+		return this->m_sample_ptrs;
+	}
+
+	/*
+	 * Same selection as BamReader::fetchBamAlignmentPtrsInRegion. Safe to call from several threads, each call reads with its own handle.
+	 */
+	void HTSAlignmentReader::fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads)
+	{
+		int refID = bam_name2id(this->m_header_ptr, regionPtr->getReferenceID().c_str());
+		if (refID < 0)
+		{
+			return;
+		}
+		hts_itr_t* iteratorPtr = sam_itr_queryi(this->m_index_ptr, refID, regionPtr->getStartPosition(), regionPtr->getEndPosition());
+		if (iteratorPtr == nullptr)
+		{
+			return;
+		}
+		// the index is only read so every handle can query it at the same time
+		auto handlePtr = acquireHandle();
+		auto arenaPtr = BamAlignmentArena::getFreeArena(handlePtr->m_arena_ptrs);
+		position startPosition = regionPtr->getStartPosition();
+		position endPosition = regionPtr->getEndPosition();
+		while (sam_itr_next(handlePtr->m_file_ptr, iteratorPtr, handlePtr->m_record_ptr) >= 0)
+		{
+			const bam1_core_t& core = handlePtr->m_record_ptr->core;
+			bool isInRegion = ((int64_t)startPosition < core.pos && ((int64_t)core.pos + core.l_qseq) < (int64_t)endPosition);
+			if (((core.flag & BAM_FDUP) && !includeDuplicateReads) ||
+				(unmappedOnly && !(core.flag & BAM_FUNMAP)) || !isInRegion)
+			{
+				continue;
+			}
+			// reads from unknown read groups are dropped before they are converted
+			auto samplePtr = getRecordSamplePtr(handlePtr);
+			if (samplePtr == nullptr)
+			{
+				continue;
+			}
+			BamAlignment* bamtoolsAlignmentPtr = arenaPtr->acquire();
+			setBamToolsAlignment(handlePtr->m_record_ptr, *bamtoolsAlignmentPtr);
+			bamtoolsAlignmentPtr->setSamplePtr(samplePtr);
+			bamtoolsAlignmentPtr->computeReadID();
+			bamAlignmentPtrs.emplace_back(std::shared_ptr< BamAlignment >(arenaPtr, bamtoolsAlignmentPtr));
+			arenaPtr->commit();
+		}
+		hts_itr_destroy(iteratorPtr);
+		releaseHandle(handlePtr);
+	}
+
+	/*
+	 * Length of the first read in the file, read when the file is opened.
+	 */
+	uint32_t HTSAlignmentReader::getReadLength()
+	{
+		return this->m_read_length;
+	}
+
+	/*
+	 * Fills in the fields BamTools::BamReader::GetNextAlignment would, the tags are copied in their binary form which is what BamTools stores.
+	 */
+	void HTSAlignmentReader::setBamToolsAlignment(const bam1_t* recordPtr, BamTools::BamAlignment& bamtoolsAlignment)
+	{
+		const bam1_core_t& core = recordPtr->core;
+		bamtoolsAlignment.Name = bam_get_qname(recordPtr);
+		bamtoolsAlignment.Length = core.l_qseq;
+		bamtoolsAlignment.RefID = core.tid;
+		bamtoolsAlignment.Position = core.pos;
+		bamtoolsAlignment.Bin = core.bin;
+		bamtoolsAlignment.MapQuality = core.qual;
+		bamtoolsAlignment.AlignmentFlag = core.flag;
+		bamtoolsAlignment.MateRefID = core.mtid;
+		bamtoolsAlignment.MatePosition = core.mpos;
+		bamtoolsAlignment.InsertSize = core.isize;
+
+		const uint8_t* sequence = bam_get_seq(recordPtr);
+		bamtoolsAlignment.QueryBases.resize(core.l_qseq);
+		for (int32_t i = 0; i < core.l_qseq; ++i)
+		{
+			bamtoolsAlignment.QueryBases[i] = seq_nt16_str[bam_seqi(sequence, i)];
+		}
+		const uint8_t* qualities = bam_get_qual(recordPtr);
+		if (core.l_qseq > 0 && qualities[0] == 0xff)
+		{
+			bamtoolsAlignment.Qualities = "*"; // qualities weren't stored
+		}
+		else
+		{
+			bamtoolsAlignment.Qualities.resize(core.l_qseq);
+			for (int32_t i = 0; i < core.l_qseq; ++i)
+			{
+				bamtoolsAlignment.Qualities[i] = (char)(qualities[i] + 33);
+			}
+		}
+		bamtoolsAlignment.AlignedBases.clear();
+		bamtoolsAlignment.TagData.assign((const char*)bam_get_aux(recordPtr), bam_get_l_aux(recordPtr));
+
+		const uint32_t* cigar = bam_get_cigar(recordPtr);
+		bamtoolsAlignment.CigarData.clear();
+		for (uint32_t i = 0; i < core.n_cigar; ++i)
+		{
+			bamtoolsAlignment.CigarData.emplace_back(BAM_CIGAR_STR[bam_cigar_op(cigar[i])], bam_cigar_oplen(cigar[i]));
+		}
+	}
+}
@@ -0,0 +1,75 @@
+#ifndef GRAPHITE_HTSALIGNMENTREADER_H
+#define GRAPHITE_HTSALIGNMENTREADER_H
+
+#include "IAlignmentReader.h"
+#include "BamAlignmentArena.hpp"
+
+#include <htslib/hts.h>
+#include <htslib/sam.h>
+#include <htslib/thread_pool.h>
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace graphite
+{
+	/*
+	 * htslib backed reader for BAM and CRAM. BGZF blocks are decompressed on htslib's own
+	 * threads and CRAMs are decoded against the local reference. Records are converted to
+	 * BamTools records after filtering so rejected records are never converted.
+	 */
+	class HTSAlignmentReader : public IAlignmentReader
+	{
+	public:
+		typedef std::shared_ptr< HTSAlignmentReader > SharedPtr;
+		HTSAlignmentReader(const std::string& path, const std::string& referencePath, uint32_t decompressionThreadCount);
+		~HTSAlignmentReader();
+
+		// every fetch is an index query, htslib already reads ahead on its decompression threads
+		void enablePrefetch() override {}
+		void enableSweep() override {}
+		void prefetchRegion(Region::SharedPtr regionPtr) override {}
+		void fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads) override;
+		void evictAlignmentsBefore(const std::string& referenceID, position evictionPosition) override {}
+
+		std::vector< Sample::SharedPtr > getSamplePtrs() override;
+		uint32_t getReadLength() override;
+
+	private:
+		/*
+		 * An open file with its own position, the header, index and decompression threads are shared by every handle.
+		 */
+		struct ReaderHandle
+		{
+			htsFile* m_file_ptr;
+			bam1_t* m_record_ptr;
+			std::vector< BamAlignmentArena::SharedPtr > m_arena_ptrs;
+			std::string m_read_group; // the RG tag of the record being decoded
+		};
+
+		ReaderHandle* openHandle();
+		ReaderHandle* acquireHandle();
+		void releaseHandle(ReaderHandle* handlePtr);
+		void initializeSamplePtrs();
+		Sample::SharedPtr getRecordSamplePtr(ReaderHandle* handlePtr);
+		static void setBamToolsAlignment(const bam1_t* recordPtr, BamTools::BamAlignment& bamtoolsAlignment);
+
+		std::string m_path;
+		std::string m_reference_path;
+		bam_hdr_t* m_header_ptr;
+		hts_idx_t* m_index_ptr;
+		htsThreadPool m_thread_pool;
+		uint32_t m_read_length;
+		std::vector< std::unique_ptr< ReaderHandle > > m_handle_ptrs; // owns every handle
+		std::vector< ReaderHandle* > m_free_handle_ptrs;
+		std::mutex m_handle_lock;
+		std::vector< Sample::SharedPtr > m_sample_ptrs;
+		std::unordered_map< std::string, Sample::SharedPtr > m_read_group_sample_ptrs; // filled in the constructor, only read afterwards
+	};
+}
+
+#endif //GRAPHITE_HTSALIGNMENTREADER_H
@@ -0,0 +1,16 @@
+#include "IAlignmentReader.h"
+#include "BamReader.h"
+#include "HTSAlignmentReader.h"
+
+namespace graphite
+{
+	IAlignmentReader::SharedPtr IAlignmentReader::openAlignmentReader(const std::string& path, const std::string& referencePath, uint32_t decompressionThreadCount)
+	{
+		std::string extension = path.substr(path.find_last_of(".") + 1);
+		if (extension == "cram" || decompressionThreadCount > 0)
+		{
+			return std::make_shared< HTSAlignmentReader >(path, referencePath, decompressionThreadCount);
+		}
+		return std::make_shared< BamReader >(path);
+	}
+}
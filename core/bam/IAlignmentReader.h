@@ -0,0 +1,45 @@
+#ifndef GRAPHITE_IALIGNMENTREADER_H
+#define GRAPHITE_IALIGNMENTREADER_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/region/Region.h"
+#include "core/sample/Sample.h"
+#include "BamAlignment.h"
+
+#include <memory>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+namespace graphite
+{
+	/*
+	 * Reads alignments for the graph processor. Every implementation hands out BamTools records
+	 * so the graphs don't depend on the file format. Reads whose read group isn't in the header are dropped.
+	 */
+	class IAlignmentReader : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< IAlignmentReader > SharedPtr;
+		IAlignmentReader() {}
+		virtual ~IAlignmentReader() {}
+
+		/*
+		 * Picks the implementation from the file extension: CRAMs are always read with htslib (referencePath is
+		 * used to decode them), BAMs are read with htslib when decompressionThreadCount is set and with BamTools otherwise.
+		 */
+		static SharedPtr openAlignmentReader(const std::string& path, const std::string& referencePath, uint32_t decompressionThreadCount);
+
+		virtual void enablePrefetch() = 0;
+		virtual void enableSweep() = 0;
+		virtual void prefetchRegion(Region::SharedPtr regionPtr) = 0;
+		virtual void fetchBamAlignmentPtrsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs,  Region::SharedPtr regionPtr, bool unmappedOnly, bool includeDuplicateReads) = 0;
+		virtual void evictAlignmentsBefore(const std::string& referenceID, position evictionPosition) = 0;
+
+		// one sample per read group in the order of the header's read groups
+		virtual std::vector< Sample::SharedPtr > getSamplePtrs() = 0;
+		virtual uint32_t getReadLength() = 0;
+	};
+}
+
+#endif //GRAPHITE_IALIGNMENTREADER_H
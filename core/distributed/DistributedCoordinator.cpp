@@ -0,0 +1,310 @@
+#include "DistributedCoordinator.h"
+#include "DistributedWorker.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace graphite
+{
+	DistributedCoordinator::DistributedCoordinator(ShardProcessor::SharedPtr shardProcessorPtr, const std::vector< std::string >& arguments, uint32_t workerCount, uint32_t maxAttempts) :
+		m_shard_processor_ptr(shardProcessorPtr),
+		m_arguments(arguments),
+		m_worker_count(std::max< uint32_t >(1, workerCount)),
+		m_max_attempts(std::max< uint32_t >(1, maxAttempts))
+	{
+	}
+
+	DistributedCoordinator::~DistributedCoordinator()
+	{
+		for (auto& worker : this->m_workers)
+		{
+			if (worker.m_pid > 0)
+			{
+				kill(worker.m_pid, SIGTERM);
+				stopWorker(worker, false);
+			}
+		}
+	}
+
+	void DistributedCoordinator::process(uint32_t unitCount)
+	{
+		this->m_units = this->m_shard_processor_ptr->partition(unitCount);
+		if (this->m_units.empty())
+		{
+			// nothing to adjudicate, only the headers are written
+			this->m_shard_processor_ptr->process(1, 1);
+			return;
+		}
+
+		// a dead worker is noticed through its pipe, not through a signal
+		signal(SIGPIPE, SIG_IGN);
+
+		this->m_pending_unit_indices.clear();
+		for (uint32_t i = 0; i < this->m_units.size(); ++i)
+		{
+			this->m_pending_unit_indices.emplace_back(i);
+		}
+		this->m_unit_attempts.assign(this->m_units.size(), 0);
+		this->m_unit_completed.assign(this->m_units.size(), false);
+		this->m_workers.resize(std::min< size_t >(this->m_worker_count, this->m_units.size()));
+		for (auto& worker : this->m_workers)
+		{
+			worker.m_pid = -1;
+			worker.m_read_fd = -1;
+			worker.m_write_fd = -1;
+			worker.m_unit_index = -1;
+		}
+
+		this->m_shard_processor_ptr->resetOutputs();
+		uint32_t nextMergeIndex = 0;
+		while (nextMergeIndex < this->m_units.size())
+		{
+			// hand out pending units to idle workers, relaunching workers that died
+			for (auto& worker : this->m_workers)
+			{
+				while (worker.m_unit_index < 0 && !this->m_pending_unit_indices.empty())
+				{
+					if (worker.m_pid < 0 && !launchWorker(worker))
+					{
+						std::cout << "Unable to launch a worker process" << std::endl;
+						exit(EXIT_FAILURE);
+					}
+					uint32_t unitIndex = this->m_pending_unit_indices.front();
+					this->m_pending_unit_indices.pop_front();
+					if (!assignUnit(worker, unitIndex))
+					{
+						stopWorker(worker, false);
+						failUnit(unitIndex);
+					}
+				}
+			}
+
+			std::vector< pollfd > pollFDs;
+			std::vector< WorkerProcess* > pollWorkers;
+			for (auto& worker : this->m_workers)
+			{
+				if (worker.m_unit_index >= 0)
+				{
+					pollfd pollFD = { worker.m_read_fd, POLLIN, 0 };
+					pollFDs.emplace_back(pollFD);
+					pollWorkers.emplace_back(&worker);
+				}
+			}
+			if (poll(pollFDs.data(), pollFDs.size(), -1) < 0)
+			{
+				if (errno == EINTR)
+				{
+					continue;
+				}
+				std::cout << "Unable to poll the worker processes" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			for (size_t i = 0; i < pollFDs.size(); ++i)
+			{
+				if (pollFDs[i].revents != 0)
+				{
+					readMessages(*pollWorkers[i]);
+				}
+			}
+
+			// units are merged in order, so a finished unit waits for every unit before it
+			while (nextMergeIndex < this->m_units.size() && this->m_unit_completed[nextMergeIndex])
+			{
+				this->m_shard_processor_ptr->appendShardOutput(this->m_shard_processor_ptr->getShardOutputDirectory(nextMergeIndex), nextMergeIndex == 0);
+				++nextMergeIndex;
+			}
+		}
+		this->m_shard_processor_ptr->finishOutputs();
+
+		for (auto& worker : this->m_workers)
+		{
+			if (worker.m_pid > 0)
+			{
+				stopWorker(worker, true);
+			}
+		}
+	}
+
+	/*
+	 * Forks and re-executes this binary as a worker. The worker's ends of the pipes are placed on
+	 * DistributedWorker::READ_FD and DistributedWorker::WRITE_FD, every other pipe is close-on-exec.
+	 */
+	bool DistributedCoordinator::launchWorker(WorkerProcess& worker)
+	{
+		int toWorker[2];
+		int fromWorker[2];
+		if (pipe2(toWorker, O_CLOEXEC) != 0)
+		{
+			return false;
+		}
+		if (pipe2(fromWorker, O_CLOEXEC) != 0)
+		{
+			close(toWorker[0]);
+			close(toWorker[1]);
+			return false;
+		}
+
+		std::vector< char* > argv;
+		for (auto& argument : this->m_arguments)
+		{
+			argv.emplace_back(const_cast< char* >(argument.c_str()));
+		}
+		std::string workerArgument = "--worker";
+		argv.emplace_back(const_cast< char* >(workerArgument.c_str()));
+		argv.emplace_back(nullptr);
+
+		pid_t pid = fork();
+		if (pid == 0)
+		{
+			// move both ends out of the way first so the dup2 calls can't clobber each other
+			int readFD = fcntl(toWorker[0], F_DUPFD_CLOEXEC, 10);
+			int writeFD = fcntl(fromWorker[1], F_DUPFD_CLOEXEC, 10);
+			if (readFD < 0 || writeFD < 0 || dup2(readFD, DistributedWorker::READ_FD) < 0 || dup2(writeFD, DistributedWorker::WRITE_FD) < 0)
+			{
+				_exit(EXIT_FAILURE);
+			}
+			execv("/proc/self/exe", argv.data());
+			_exit(EXIT_FAILURE);
+		}
+		close(toWorker[0]);
+		close(fromWorker[1]);
+		if (pid < 0)
+		{
+			close(toWorker[1]);
+			close(fromWorker[0]);
+			return false;
+		}
+		worker.m_pid = pid;
+		worker.m_read_fd = fromWorker[0];
+		worker.m_write_fd = toWorker[1];
+		worker.m_unit_index = -1;
+		worker.m_read_buffer.clear();
+		return true;
+	}
+
+	void DistributedCoordinator::stopWorker(WorkerProcess& worker, bool sendExit)
+	{
+		if (sendExit)
+		{
+			std::string message = "EXIT\n";
+			if (write(worker.m_write_fd, message.c_str(), message.size())) {}
+		}
+		close(worker.m_write_fd);
+		close(worker.m_read_fd);
+		waitpid(worker.m_pid, nullptr, 0);
+		worker.m_pid = -1;
+		worker.m_read_fd = -1;
+		worker.m_write_fd = -1;
+		worker.m_unit_index = -1;
+		worker.m_read_buffer.clear();
+	}
+
+	bool DistributedCoordinator::assignUnit(WorkerProcess& worker, uint32_t unitIndex)
+	{
+		std::string message = "UNIT " + std::to_string(unitIndex);
+		for (auto regionPtr : this->m_units[unitIndex])
+		{
+			message += " " + regionPtr->getRegionString();
+		}
+		message += "\n";
+
+		this->m_unit_attempts[unitIndex] += 1;
+		worker.m_unit_index = unitIndex;
+		size_t written = 0;
+		while (written < message.size())
+		{
+			ssize_t writeCount = write(worker.m_write_fd, message.c_str() + written, message.size() - written);
+			if (writeCount < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (writeCount <= 0)
+			{
+				return false;
+			}
+			written += writeCount;
+		}
+		return true;
+	}
+
+	void DistributedCoordinator::readMessages(WorkerProcess& worker)
+	{
+		char buffer[4096];
+		ssize_t readCount = read(worker.m_read_fd, buffer, sizeof(buffer));
+		if (readCount < 0 && errno == EINTR)
+		{
+			return;
+		}
+		if (readCount <= 0)
+		{
+			// the worker exited or crashed, its unit is retried by another worker
+			int32_t unitIndex = worker.m_unit_index;
+			stopWorker(worker, false);
+			if (unitIndex >= 0)
+			{
+				failUnit(unitIndex);
+			}
+			return;
+		}
+		worker.m_read_buffer.append(buffer, readCount);
+		size_t lineEnd;
+		while ((lineEnd = worker.m_read_buffer.find('\n')) != std::string::npos)
+		{
+			std::string message = worker.m_read_buffer.substr(0, lineEnd);
+			worker.m_read_buffer.erase(0, lineEnd + 1);
+			size_t separator = message.find(' ');
+			if (separator == std::string::npos || worker.m_unit_index < 0)
+			{
+				continue;
+			}
+			uint32_t unitIndex = std::stoul(message.substr(separator + 1));
+			if (unitIndex != (uint32_t)worker.m_unit_index)
+			{
+				continue;
+			}
+			unitFinished(worker, unitIndex, message.compare(0, separator, "DONE") == 0);
+		}
+	}
+
+	void DistributedCoordinator::unitFinished(WorkerProcess& worker, uint32_t unitIndex, bool succeeded)
+	{
+		worker.m_unit_index = -1;
+		if (succeeded)
+		{
+			this->m_unit_completed[unitIndex] = true;
+		}
+		else
+		{
+			failUnit(unitIndex);
+		}
+	}
+
+	/*
+	 * Puts the unit back at the front of the queue or gives up once it has been tried maxAttempts times.
+	 */
+	void DistributedCoordinator::failUnit(uint32_t unitIndex)
+	{
+		if (this->m_unit_attempts[unitIndex] >= this->m_max_attempts)
+		{
+			std::cout << "Work unit " << unitIndex << " failed after " << this->m_unit_attempts[unitIndex] << " attempts" << std::endl;
+			for (auto& worker : this->m_workers)
+			{
+				if (worker.m_pid > 0)
+				{
+					kill(worker.m_pid, SIGTERM);
+					stopWorker(worker, false);
+				}
+			}
+			exit(EXIT_FAILURE);
+		}
+		this->m_pending_unit_indices.emplace_front(unitIndex);
+	}
+}
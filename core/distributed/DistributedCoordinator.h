@@ -0,0 +1,61 @@
+#ifndef GRAPHITE_DISTRIBUTEDCOORDINATOR_H
+#define GRAPHITE_DISTRIBUTEDCOORDINATOR_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/shard/ShardProcessor.h"
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <sys/types.h>
+
+namespace graphite
+{
+	/*
+	 * Splits the input VCFs into work units with the ShardProcessor and hands them to worker processes
+	 * (see DistributedWorker for the protocol). Finished units are merged into the final outputs in
+	 * unit order and units whose worker fails or dies are handed out again up to maxAttempts times.
+	 * Workers are launched by re-executing this binary with the original arguments plus --worker.
+	 */
+	class DistributedCoordinator : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< DistributedCoordinator > SharedPtr;
+		DistributedCoordinator(ShardProcessor::SharedPtr shardProcessorPtr, const std::vector< std::string >& arguments, uint32_t workerCount, uint32_t maxAttempts);
+		~DistributedCoordinator();
+
+		void process(uint32_t unitCount);
+
+	private:
+		struct WorkerProcess
+		{
+			pid_t m_pid;
+			int m_read_fd;
+			int m_write_fd;
+			int32_t m_unit_index; // -1 while idle
+			std::string m_read_buffer;
+		};
+
+		bool launchWorker(WorkerProcess& worker);
+		void stopWorker(WorkerProcess& worker, bool sendExit);
+		bool assignUnit(WorkerProcess& worker, uint32_t unitIndex);
+		void readMessages(WorkerProcess& worker);
+		void unitFinished(WorkerProcess& worker, uint32_t unitIndex, bool succeeded);
+		void failUnit(uint32_t unitIndex);
+
+		ShardProcessor::SharedPtr m_shard_processor_ptr;
+		std::vector< std::string > m_arguments;
+		uint32_t m_worker_count;
+		uint32_t m_max_attempts;
+
+		std::vector< WorkerProcess > m_workers;
+		std::vector< std::vector< Region::SharedPtr > > m_units;
+		std::deque< uint32_t > m_pending_unit_indices;
+		std::vector< uint32_t > m_unit_attempts;
+		std::vector< bool > m_unit_completed;
+	};
+}
+
+#endif //GRAPHITE_DISTRIBUTEDCOORDINATOR_H
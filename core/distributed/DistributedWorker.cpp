@@ -0,0 +1,114 @@
+#include "DistributedWorker.h"
+
+#include "core/util/Utility.h"
+
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace graphite
+{
+	const int DistributedWorker::READ_FD;
+	const int DistributedWorker::WRITE_FD;
+
+	DistributedWorker::DistributedWorker(ShardProcessor::SharedPtr shardProcessorPtr, int readFD, int writeFD, uint32_t threadCount) :
+		m_shard_processor_ptr(shardProcessorPtr),
+		m_read_fd(readFD),
+		m_write_fd(writeFD),
+		m_thread_count(threadCount)
+	{
+	}
+
+	DistributedWorker::~DistributedWorker()
+	{
+		close(this->m_read_fd);
+		close(this->m_write_fd);
+	}
+
+	/*
+	 * Processes units until the coordinator sends EXIT or goes away.
+	 */
+	void DistributedWorker::process()
+	{
+		std::string message;
+		while (readLine(message))
+		{
+			if (message == "EXIT")
+			{
+				break;
+			}
+			uint32_t unitIndex = 0;
+			bool succeeded = processUnit(message, unitIndex);
+			writeLine(std::string((succeeded) ? "DONE " : "FAILED ") + std::to_string(unitIndex));
+		}
+	}
+
+	bool DistributedWorker::processUnit(const std::string& message, uint32_t& unitIndex)
+	{
+		std::vector< std::string > tokens;
+		split(message, ' ', tokens);
+		if (tokens.size() < 2 || tokens[0] != "UNIT")
+		{
+			return false;
+		}
+		try
+		{
+			unitIndex = std::stoul(tokens[1]);
+			std::vector< Region::SharedPtr > regionPtrs;
+			for (size_t i = 2; i < tokens.size(); ++i)
+			{
+				regionPtrs.emplace_back(std::make_shared< Region >(tokens[i], Region::BASED::ONE));
+			}
+			std::string unitOutputDirectory = this->m_shard_processor_ptr->getShardOutputDirectory(unitIndex);
+			mkdir(unitOutputDirectory.c_str(), 0755);
+			this->m_shard_processor_ptr->processShard(regionPtrs, unitOutputDirectory, this->m_thread_count, false);
+		}
+		catch (...)
+		{
+			return false;
+		}
+		return true;
+	}
+
+	bool DistributedWorker::readLine(std::string& line)
+	{
+		size_t lineEnd;
+		while ((lineEnd = this->m_read_buffer.find('\n')) == std::string::npos)
+		{
+			char buffer[4096];
+			ssize_t readCount = read(this->m_read_fd, buffer, sizeof(buffer));
+			if (readCount < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (readCount <= 0)
+			{
+				return false;
+			}
+			this->m_read_buffer.append(buffer, readCount);
+		}
+		line = this->m_read_buffer.substr(0, lineEnd);
+		this->m_read_buffer.erase(0, lineEnd + 1);
+		return true;
+	}
+
+	void DistributedWorker::writeLine(const std::string& line)
+	{
+		std::string message = line + "\n";
+		size_t written = 0;
+		while (written < message.size())
+		{
+			ssize_t writeCount = write(this->m_write_fd, message.c_str() + written, message.size() - written);
+			if (writeCount < 0 && errno == EINTR)
+			{
+				continue;
+			}
+			if (writeCount <= 0)
+			{
+				return;
+			}
+			written += writeCount;
+		}
+	}
+}
@@ -0,0 +1,46 @@
+#ifndef GRAPHITE_DISTRIBUTEDWORKER_H
+#define GRAPHITE_DISTRIBUTEDWORKER_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/shard/ShardProcessor.h"
+
+#include <memory>
+#include <string>
+
+namespace graphite
+{
+	/*
+	 * Worker side of the coordinator protocol. The coordinator sends one line per message:
+	 *   UNIT <unit index> <region> [<region> ...]   adjudicate the variants in the regions into the unit's shard directory
+	 *   EXIT                                        no more work
+	 * and the worker answers every UNIT with
+	 *   DONE <unit index>  or  FAILED <unit index>
+	 * The protocol only needs a pair of file descriptors so pipes or sockets both work. Local workers
+	 * get their descriptors as READ_FD and WRITE_FD so nothing printed to stdout can corrupt the protocol.
+	 */
+	class DistributedWorker : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< DistributedWorker > SharedPtr;
+		DistributedWorker(ShardProcessor::SharedPtr shardProcessorPtr, int readFD, int writeFD, uint32_t threadCount);
+		~DistributedWorker();
+
+		void process();
+
+		static const int READ_FD = 3;
+		static const int WRITE_FD = 4;
+
+	private:
+		bool processUnit(const std::string& message, uint32_t& unitIndex);
+		bool readLine(std::string& line);
+		void writeLine(const std::string& line);
+
+		ShardProcessor::SharedPtr m_shard_processor_ptr;
+		int m_read_fd;
+		int m_write_fd;
+		uint32_t m_thread_count;
+		std::string m_read_buffer;
+	};
+}
+
+#endif //GRAPHITE_DISTRIBUTEDWORKER_H
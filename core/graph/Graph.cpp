@@ -1,6 +1,7 @@
 #include "Graph.h"
 
 #include "core/util/Types.h"
+#include <algorithm>
 #include <deque>
 
 namespace graphite
@@ -39,6 +40,8 @@ namespace graphite
 
 	void Graph::generateGraph()
 	{
+		// variants from several vcfs arrive one vcf after another
+		std::stable_sort(this->m_variant_ptrs.begin(), this->m_variant_ptrs.end(), [](const Variant::SharedPtr& a, const Variant::SharedPtr& b) { return a->getPosition() < b->getPosition(); });
 		std::string referenceSequence;
 		Region::SharedPtr referenceRegionPtr;
 		getGraphReference(referenceSequence, referenceRegionPtr);
@@ -58,6 +61,11 @@ namespace graphite
 		return this->m_graph_regions;
 	}
 
+	void Graph::setReadCount(uint32_t readCount)
+	{
+		this->m_aligned_read_indices.resize(readCount);
+	}
+
 	void Graph::compressLargeNodes()
 	{
 		std::deque< Node::SharedPtr > nodes;
@@ -168,8 +176,12 @@ namespace graphite
 			}
 		} while (nodePtr->getOutNodes().size() > 0);
 
+		// variants at the same position (from different vcfs) all connect to the alternate nodes of the position before them
 		position previousPosition = 0;
-		std::vector< Node::SharedPtr > previousNodes;
+		std::vector< Node::SharedPtr > previousNodes; // alternate nodes at previousPosition
+		position currentPosition = 0;
+		std::vector< Node::SharedPtr > currentNodes; // alternate nodes at currentPosition
+		std::unordered_map< Allele*, Node::SharedPtr > alleleNodePtrs; // alleles shared by identical variants get a single node
 		for (auto variantPtr : this->m_variant_ptrs)
 		{
 			position variantPosition = variantPtr->getPosition() - 1;
@@ -190,9 +202,25 @@ namespace graphite
 				std::cout << "Invalid Graph: addVariantsToGraph, position: " << variantPtr->getPosition() << std::endl;
 				exit(EXIT_FAILURE);
 			}
-			std::vector< Node::SharedPtr > tmpPreviousNodes;
+			if (variantPtr->getPosition() != currentPosition)
+			{
+				previousNodes = currentNodes;
+				previousPosition = currentPosition;
+				currentNodes.clear();
+				currentPosition = variantPtr->getPosition();
+			}
 			for (auto altAllelePtr : variantPtr->getAlternateAllelePtrs())
 			{
+				auto alleleNodeIter = alleleNodePtrs.find(altAllelePtr.get());
+				if (alleleNodeIter != alleleNodePtrs.end())
+				{
+					// a shared allele's node already has its edges, it only has to stay in the adjacency bookkeeping
+					if (std::find(currentNodes.begin(), currentNodes.end(), alleleNodeIter->second) == currentNodes.end())
+					{
+						currentNodes.emplace_back(alleleNodeIter->second);
+					}
+					continue;
+				}
 				auto altNodePtr = std::make_shared< Node >(altAllelePtr->getSequence(), variantPosition, Node::ALLELE_TYPE::ALT);
 				this->m_all_created_nodes.emplace(altNodePtr);
 				// altNodePtr->addOverlappingAllelePtr(altAllelePtr);
@@ -209,12 +237,9 @@ namespace graphite
 						altNodePtr->addInNode(prevNode);
 					}
 				}
-				tmpPreviousNodes.emplace_back(altNodePtr);
+				alleleNodePtrs.emplace(altAllelePtr.get(), altNodePtr);
+				currentNodes.emplace_back(altNodePtr);
 			}
-			previousNodes.clear();
-			previousNodes = tmpPreviousNodes;
-			previousPosition = variantPtr->getPosition();
-
 		}
 	}
 	Node::SharedPtr Graph::condenseGraph(Node::SharedPtr lastNodePtr)
@@ -323,8 +348,12 @@ namespace graphite
 		}
 	}
 
-	void Graph::adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent)
+	void Graph::adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent)
 	{
+		if (this->m_aligned_read_indices.testAndSet(readIndex))
+		{
+			return;
+		}
 		gssw_sse2_disable();
 		int8_t* nt_table = gssw_create_nt_table();
 		int8_t* mat = gssw_create_score_matrix(matchValue, mismatchValue);
@@ -369,7 +398,7 @@ namespace graphite
 
 		gssw_graph_fill(graph, bamAlignmentPtr->QueryBases.c_str(), nt_table, mat, gapOpenValue, gapExtensionValue, 0, 0, 15, 2, true);
 		gssw_graph_mapping* gm = gssw_graph_trace_back (graph, bamAlignmentPtr->QueryBases.c_str(), bamAlignmentPtr->QueryBases.size(), nt_table, mat, gapOpenValue, gapExtensionValue, 0, 0);
-		processTraceback(gm, bamAlignmentPtr, samplePtr, !bamAlignmentPtr->IsReverseStrand(), matchValue, mismatchValue, gapOpenValue, gapExtensionValue, referenceTotalScorePercent);
+		processTraceback(gm, bamAlignmentPtr, readIndex, samplePtr, !bamAlignmentPtr->IsReverseStrand(), matchValue, mismatchValue, gapOpenValue, gapExtensionValue, referenceTotalScorePercent);
 		gssw_graph_mapping_destroy(gm);
 
 		// note that nodes which are referred to in this graph are destroyed as well
@@ -379,17 +408,8 @@ namespace graphite
 		free(mat);
 	}
 
-	void Graph::processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent)
+	void Graph::processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent)
 	{
-		std::string alignmentName = bamAlignmentPtr->Name + std::to_string(bamAlignmentPtr->IsFirstMate());
-		{
-			std::lock_guard< std::mutex > l(m_aligned_read_names_mutex);
-			if (this->m_aligned_read_names.find(alignmentName) != this->m_aligned_read_names.end())
-			{
-				return;
-			}
-			this->m_aligned_read_names.emplace(alignmentName);
-		}
 		std::vector< std::tuple< Node*, uint32_t > > nodePtrScoreTuples;
 		uint32_t totalScore = 0;
 		gssw_node_cigar* nc = graphMapping->cigar.elements;
@@ -454,6 +474,7 @@ namespace graphite
 		}
 
 		float totalScorePercent = ((float)(totalScore))/((float)(bamAlignmentPtr->Length - softclipLength)) * 100;
+		uint32_t sampleIndex = samplePtr->getIndex();
 		uint32_t count = 0;
 		// static std::mutex lo;
 		// std::lock_guard< std::mutex > lock(lo);
@@ -526,11 +547,11 @@ namespace graphite
 
 			if ((totalScorePercent == referenceTotalScorePercent && hasAlternate) || isAmbiguous)
 			{
-				nodePtr->incrementScoreCount(bamAlignmentPtr, samplePtr, isForwardStrand, -1);
+				nodePtr->incrementScoreCount(readIndex, sampleIndex, isForwardStrand, -1);
 			}
 			else if (totalScorePercent < m_score_threshold || softclipCount > 1)
 			{
-				nodePtr->incrementScoreCount(bamAlignmentPtr, samplePtr, isForwardStrand, 0);
+				nodePtr->incrementScoreCount(readIndex, sampleIndex, isForwardStrand, 0);
 			}
 			else
 			{
@@ -542,7 +563,7 @@ namespace graphite
 					std::cout << "---" << std::endl;
 				}
 				*/
-				nodePtr->incrementScoreCount(bamAlignmentPtr, samplePtr, isForwardStrand, nodeScore);
+				nodePtr->incrementScoreCount(readIndex, sampleIndex, isForwardStrand, nodeScore);
 				if (m_graph_printer_ptr != nullptr)
 				{
 					m_graph_printer_ptr->registerTraceback(graphMapping, bamAlignmentPtr, totalScorePercent);
@@ -3,6 +3,7 @@
 
 #include "core/util/Noncopyable.hpp"
 #include "core/util/GraphPrinter.h"
+#include "core/util/AtomicBitmap.hpp"
 #include "core/region/Region.h"
 #include "core/reference/FastaReference.h"
 #include "core/vcf/Variant.h"
@@ -26,7 +27,8 @@ namespace graphite
 		~Graph();
 
 		std::vector< Region::SharedPtr > getRegionPtrs();
-		void adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent);
+		void setReadCount(uint32_t readCount);
+		void adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent);
         std::vector< std::vector< Node::SharedPtr > > generateAllPaths();
 		Region::SharedPtr getGraphRegion();
 		std::string getReferenceSequence();
@@ -40,7 +42,7 @@ namespace graphite
         void generateReferenceGraphNode(Node::SharedPtr& firstNodePtr, Node::SharedPtr& lastNodePtr, const std::string& referenceSequence, Region::SharedPtr regionPtr);
 		void addVariantsToGraph(Node::SharedPtr firstNodePtr);
 		Node::SharedPtr condenseGraph(Node::SharedPtr lastNodePtr);
-		void processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent);
+		void processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue, float referenceTotalScorePercent);
 		std::vector< std::string > generateAllPathsFromNodesOfLength(Node::SharedPtr nodePtr);
 		void setPrefixAndSuffix(Node::SharedPtr firstNodePtr);
 
@@ -55,8 +57,7 @@ namespace graphite
 		Node::SharedPtr m_first_node;
 		uint32_t m_score_threshold;
 		std::unordered_set< Node::SharedPtr > m_all_created_nodes;
-		std::unordered_set< std::string > m_aligned_read_names;
-		std::mutex m_aligned_read_names_mutex;
+		AtomicBitmap m_aligned_read_indices; // indexed by the read's dense index within the cluster
         GraphPrinter::SharedPtr m_graph_printer_ptr;
 		/* std::unordered_map< Node::SharedPtr, std::vector< std::string > m_paths_from_node; */
 	};
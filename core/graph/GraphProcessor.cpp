@@ -9,7 +9,7 @@
 
 namespace graphite
 {
-	GraphProcessor::GraphProcessor(FastaReference::SharedPtr fastaReferencePtr, const std::vector< BamReader::SharedPtr >& bamReaderPtrs, const std::vector< VCFReader::SharedPtr >& vcfReaderPtrs,  uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph) :
+	GraphProcessor::GraphProcessor(FastaReference::SharedPtr fastaReferencePtr, const std::vector< IAlignmentReader::SharedPtr >& bamReaderPtrs, const std::vector< VCFReader::SharedPtr >& vcfReaderPtrs,  uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph, uint32_t threadCount, uint32_t maxDepth) :
 		m_fasta_reference_ptr(fastaReferencePtr),
 		m_bam_reader_ptrs(bamReaderPtrs),
 		m_vcf_reader_ptrs(vcfReaderPtrs),
@@ -18,15 +18,17 @@ namespace graphite
 		m_mismatch_value(mismatchValue),
 		m_gap_open_value(gapOpenValue),
 		m_gap_extension_value(gapExtensionValue),
-		m_thread_pool(std::thread::hardware_concurrency() * 2),
-		m_print_graphs(printGraph)
+		m_thread_pool(threadCount),
+		m_print_graphs(printGraph),
+		m_max_depth(maxDepth)
 	{
+		// the samples were given dense indices before the vcf writers were created, see ShardProcessor::processShard
+		this->m_sample_count = 0;
 		for (auto bamReaderPtr : bamReaderPtrs)
 		{
-			auto bamSamplePtrs = bamReaderPtr->getSamplePtrs();
-			for (auto samplePtr: bamSamplePtrs)
+			for (auto samplePtr : bamReaderPtr->getSamplePtrs())
 			{
-				this->m_bam_sample_ptrs.emplace(samplePtr->getReadgroup(), samplePtr);
+				this->m_sample_count = std::max< uint32_t >(this->m_sample_count, samplePtr->getIndex() + 1);
 			}
 		}
 	}
@@ -35,37 +37,161 @@ namespace graphite
 	{
 	}
 
-	void GraphProcessor::processVariants()
+	uint32_t GraphProcessor::getGraphSpacing(const std::vector< IAlignmentReader::SharedPtr >& bamReaderPtrs)
 	{
 		uint32_t graphSpacing = 200;
 		// set the graph spacing to be the largest read size
-		for (auto bamReaderPtr : this->m_bam_reader_ptrs) { graphSpacing = (graphSpacing >= bamReaderPtr->getReadLength()) ? graphSpacing : bamReaderPtr->getReadLength(); }
+		for (auto bamReaderPtr : bamReaderPtrs) { graphSpacing = (graphSpacing >= bamReaderPtr->getReadLength()) ? graphSpacing : bamReaderPtr->getReadLength(); }
+		return graphSpacing;
+	}
+
+	void GraphProcessor::processVariants()
+	{
+		uint32_t graphSpacing = getGraphSpacing(this->m_bam_reader_ptrs);
 		std::vector< Variant::SharedPtr > variantPtrs;
-		while (true)
+		std::vector< Variant::SharedPtr > nextVariantPtrs;
+		getNextVariants(variantPtrs, graphSpacing);
+		prefetchVariants(variantPtrs, graphSpacing);
+		// only adjudicate if there are variants to adjudicate
+		while (variantPtrs.size() > 0)
 		{
-			variantPtrs.clear();
-			for (auto vcfReaderPtr : this->m_vcf_reader_ptrs)
+			// read the next cluster first so its bam blocks are prefetched while this one is adjudicated
+			getNextVariants(nextVariantPtrs, graphSpacing);
+			prefetchVariants(nextVariantPtrs, graphSpacing);
+
+			adjudicateVariants(variantPtrs, graphSpacing);
+			// for (auto variantPtr : variantPtrs)
+			for (int i = 0; i < variantPtrs.size(); ++i)
 			{
-				vcfReaderPtr->getNextVariants(variantPtrs, graphSpacing);
+				auto variantPtr = variantPtrs[i];
+				variantPtr->writeVariant();
 			}
-			// only adjudicate if there are variants to adjudicate
-			if (variantPtrs.size() > 0)
+			variantPtrs.swap(nextVariantPtrs);
+		}
+	}
+
+	/*
+	 * Returns the next cluster over every vcf. Each reader's next cluster is held back until it comes first,
+	 * then the clusters of the other readers within a graph spacing of it are merged in, so every vcf's variants
+	 * at a site are adjudicated on the same graph.
+	 */
+	void GraphProcessor::getNextVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing)
+	{
+		variantPtrs.clear();
+		this->m_pending_variant_ptrs.resize(this->m_vcf_reader_ptrs.size());
+		auto refill = [this, graphSpacing](size_t readerIndex)
+		{
+			auto& pendingVariantPtrs = this->m_pending_variant_ptrs[readerIndex];
+			if (pendingVariantPtrs.empty() && this->m_vcf_reader_ptrs[readerIndex]->getNextVariants(pendingVariantPtrs, graphSpacing))
 			{
-				adjudicateVariants(variantPtrs, graphSpacing);
-				// for (auto variantPtr : variantPtrs)
-				for (int i = 0; i < variantPtrs.size(); ++i)
+				this->m_chromosome_ranks.emplace(pendingVariantPtrs[0]->getChromosome(), this->m_chromosome_ranks.size());
+			}
+		};
+		int firstReaderIndex = -1;
+		for (size_t i = 0; i < this->m_pending_variant_ptrs.size(); ++i)
+		{
+			refill(i);
+			if (!this->m_pending_variant_ptrs[i].empty() && (firstReaderIndex < 0 || isVariantBefore(this->m_pending_variant_ptrs[i][0], this->m_pending_variant_ptrs[firstReaderIndex][0])))
+			{
+				firstReaderIndex = i;
+			}
+		}
+		if (firstReaderIndex < 0)
+		{
+			return;
+		}
+
+		std::string chromosome = this->m_pending_variant_ptrs[firstReaderIndex][0]->getChromosome();
+		position lastPosition = 0;
+		auto take = [&](size_t readerIndex)
+		{
+			auto& pendingVariantPtrs = this->m_pending_variant_ptrs[readerIndex];
+			for (auto variantPtr : pendingVariantPtrs)
+			{
+				lastPosition = std::max(lastPosition, variantPtr->getPosition());
+			}
+			variantPtrs.insert(variantPtrs.end(), pendingVariantPtrs.begin(), pendingVariantPtrs.end());
+			pendingVariantPtrs.clear();
+			refill(readerIndex); // the reader's next cluster can still be close to another reader's
+		};
+		take(firstReaderIndex);
+		bool merged = true;
+		while (merged)
+		{
+			merged = false;
+			for (size_t i = 0; i < this->m_pending_variant_ptrs.size(); ++i)
+			{
+				auto& pendingVariantPtrs = this->m_pending_variant_ptrs[i];
+				if (!pendingVariantPtrs.empty() && pendingVariantPtrs[0]->getChromosome() == chromosome && pendingVariantPtrs[0]->getPosition() < lastPosition + graphSpacing)
 				{
-					auto variantPtr = variantPtrs[i];
-					variantPtr->writeVariant();
+					take(i);
+					merged = true;
 				}
 			}
-			else
+		}
+		mergeIdenticalAlleles(variantPtrs);
+	}
+
+	bool GraphProcessor::isVariantBefore(Variant::SharedPtr variantPtr, Variant::SharedPtr otherVariantPtr)
+	{
+		if (variantPtr->getChromosome() == otherVariantPtr->getChromosome())
+		{
+			return variantPtr->getPosition() < otherVariantPtr->getPosition();
+		}
+		return this->m_chromosome_ranks[variantPtr->getChromosome()] < this->m_chromosome_ranks[otherVariantPtr->getChromosome()];
+	}
+
+	/*
+	 * Variants reporting the same reference and alternate sequence at the same position share one allele, so it
+	 * is a single path through the graph, reads aren't split between identical paths as ambiguous and its counts are
+	 * written by every variant (and so into every vcf) that reports it.
+	 */
+	void GraphProcessor::mergeIdenticalAlleles(std::vector< Variant::SharedPtr >& variantPtrs)
+	{
+		std::unordered_map< std::string, Allele::SharedPtr > allelePtrs; // keyed by position, reference and for alternates the alternate sequence
+		for (auto variantPtr : variantPtrs)
+		{
+			std::string siteKey = std::to_string(variantPtr->getPosition()) + "\t" + variantPtr->getReferenceAllelePtr()->getSequence();
+			variantPtr->setReferenceAllelePtr(allelePtrs.emplace(siteKey, variantPtr->getReferenceAllelePtr()).first->second);
+			auto alternateAllelePtrs = variantPtr->getAlternateAllelePtrs();
+			for (size_t i = 0; i < alternateAllelePtrs.size(); ++i)
 			{
-				break;
+				auto allelePtr = allelePtrs.emplace(siteKey + "\t" + alternateAllelePtrs[i]->getSequence(), alternateAllelePtrs[i]).first->second;
+				if (allelePtr != alternateAllelePtrs[i])
+				{
+					variantPtr->setAlternateAllelePtr(i, allelePtr);
+				}
 			}
 		}
 	}
 
+	/*
+	 * Asks the bam readers to prefetch everything getAlignmentsInRegion can fetch for the cluster, a no-op
+	 * for readers that don't have prefetching enabled.
+	 */
+	void GraphProcessor::prefetchVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing)
+	{
+		if (variantPtrs.empty())
+		{
+			return;
+		}
+		position startPosition = variantPtrs[0]->getPosition();
+		position endPosition = startPosition;
+		for (auto variantPtr : variantPtrs)
+		{
+			startPosition = std::min(startPosition, variantPtr->getPosition());
+			endPosition = std::max< position >(endPosition, variantPtr->getPosition() + variantPtr->getReferenceAllelePtr()->getSequence().size());
+		}
+		position padding = graphSpacing + this->m_flanking_padding;
+		startPosition = (startPosition > padding) ? startPosition - padding : 0;
+		endPosition = (endPosition < MAX_POSITION - padding) ? endPosition + padding : MAX_POSITION;
+		auto regionPtr = std::make_shared< Region >(variantPtrs[0]->getChromosome(), startPosition, endPosition, Region::BASED::ONE);
+		for (auto bamReaderPtr : this->m_bam_reader_ptrs)
+		{
+			bamReaderPtr->prefetchRegion(regionPtr);
+		}
+	}
+
 	void GraphProcessor::adjudicateVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing)
 	{
 		// generate graph
@@ -75,31 +201,45 @@ namespace graphite
 
 		// get all alignments
 		std::vector< std::shared_ptr< BamAlignment > > bamAlignmentPtrs;
-
-		getAlignmentsInRegion(bamAlignmentPtrs, graphRegionPtrs, true);
-		for (auto bamAlignmentPtr : bamAlignmentPtrs)
+		std::vector< float > sampleDownsampleFractions;
+		getAlignmentsInRegion(bamAlignmentPtrs, sampleDownsampleFractions, graphRegionPtrs, true);
+		for (auto variantPtr : variantPtrs)
 		{
-			std::string sampleName;
-			bamAlignmentPtr->GetTag("RG", sampleName);
-			auto iter = this->m_bam_sample_ptrs.find(sampleName);
-			if (iter != this->m_bam_sample_ptrs.end())
-			{
-				Sample::SharedPtr samplePtr = iter->second;
-				uint32_t matchValue = m_match_value;
-				uint32_t mismatchValue = m_mismatch_value;
-				uint32_t gapOpenValue = m_gap_open_value;
-				uint32_t gapExtensionValue = m_gap_extension_value;
-				auto funct = [graphPtr, refGraphPtr, bamAlignmentPtr, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue]()
-				{
-					float referenceSWScore = refGraphPtr->adjudicateAlignment(bamAlignmentPtr, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue);
-					graphPtr->adjudicateAlignment(bamAlignmentPtr, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue, referenceSWScore);
-				};
+			variantPtr->setDownsampleFractions(sampleDownsampleFractions);
+		}
+		graphPtr->setReadCount(bamAlignmentPtrs.size());
+		refGraphPtr->setReadCount(bamAlignmentPtrs.size());
 
-				// graphPtr->adjudicateAlignment(bamAlignmentPtr, iter->second, m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value);
-				// auto funct = std::bind(&Graph::adjudicateAlignment, graphPtr, bamAlignmentPtr, iter->second, m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value, false, 0);
-				m_thread_pool.enqueue(funct);
+		// one count shard per worker plus one for this thread
+		size_t scoreCountShardCount = m_thread_pool.size() + 1;
+		for (auto variantPtr : variantPtrs)
+		{
+			variantPtr->getReferenceAllelePtr()->setScoreCountShardCount(scoreCountShardCount);
+			for (auto altAllelePtr : variantPtr->getAlternateAllelePtrs())
+			{
+				altAllelePtr->setScoreCountShardCount(scoreCountShardCount);
 			}
 		}
+
+		for (uint32_t readIndex = 0; readIndex < bamAlignmentPtrs.size(); ++readIndex)
+		{
+			auto bamAlignmentPtr = bamAlignmentPtrs[readIndex];
+			// the reader resolved the read group while decoding, reads from unknown read groups were dropped there
+			Sample::SharedPtr samplePtr = bamAlignmentPtr->getSamplePtr();
+			uint32_t matchValue = m_match_value;
+			uint32_t mismatchValue = m_mismatch_value;
+			uint32_t gapOpenValue = m_gap_open_value;
+			uint32_t gapExtensionValue = m_gap_extension_value;
+			auto funct = [graphPtr, refGraphPtr, bamAlignmentPtr, readIndex, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue]()
+			{
+				float referenceSWScore = refGraphPtr->adjudicateAlignment(bamAlignmentPtr, readIndex, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue);
+				graphPtr->adjudicateAlignment(bamAlignmentPtr, readIndex, samplePtr, matchValue, mismatchValue, gapOpenValue, gapExtensionValue, referenceSWScore);
+			};
+
+			// graphPtr->adjudicateAlignment(bamAlignmentPtr, iter->second, m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value);
+			// auto funct = std::bind(&Graph::adjudicateAlignment, graphPtr, bamAlignmentPtr, iter->second, m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value, false, 0);
+			m_thread_pool.enqueue(funct);
+		}
 		m_thread_pool.join();
 		bamAlignmentPtrs.clear();
 	}
@@ -112,7 +252,8 @@ namespace graphite
 
 		// get all alignments
 		std::vector< std::shared_ptr< BamAlignment > > bamAlignmentPtrs;
-		getAlignmentsInRegion(bamAlignmentPtrs, graphRegionPtrs, true);
+		std::vector< float > sampleDownsampleFractions;
+		getAlignmentsInRegion(bamAlignmentPtrs, sampleDownsampleFractions, graphRegionPtrs, true);
 
         // uint32_t numThreads = std::thread::hardware_concurrency() * 2;
 		/*
@@ -127,14 +268,7 @@ namespace graphite
 		// uint32_t numThreads = 2;
 		for (auto bamAlignmentPtr : bamAlignmentPtrs)
 		{
-
-			std::string sampleName;
-			bamAlignmentPtr->GetTag("RG", sampleName);
-			auto iter = this->m_bam_sample_ptrs.find(sampleName);
-			if (iter != this->m_bam_sample_ptrs.end())
-			{
-				// futures.emplace_back(this->m_threadpool.enqueue(std::bind(&Graph::adjudicateAlignment, graphPtr, bamAlignmentPtr, iter->second, m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value)));
-			}
+			// futures.emplace_back(this->m_threadpool.enqueue(std::bind(&Graph::adjudicateAlignment, graphPtr, bamAlignmentPtr, bamAlignmentPtr->getSamplePtr(), m_match_value, m_mismatch_value, m_gap_open_value, m_gap_extension_value)));
 		}
 		for (auto& f : futures)
 		{
@@ -145,38 +279,173 @@ namespace graphite
 		// std::cout << "-----end-----" << std::endl;
 	}
 
-	void GraphProcessor::getAlignmentsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< Region::SharedPtr > regionPtrs, bool getFlankingUnalignedReads)
+	/*
+	 * Fetches the cluster's reads from every bam at the same time, bams after the first are fetched on the
+	 * worker pool which is idle until the cluster's reads are known. A read's position in bamAlignmentPtrs is
+	 * its dense index for the cluster. sampleDownsampleFractions gets the fraction of each sample's reads that were kept.
+	 */
+	void GraphProcessor::getAlignmentsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< float >& sampleDownsampleFractions, std::vector< Region::SharedPtr > regionPtrs, bool getFlankingUnalignedReads)
+	{
+		std::vector< std::vector< std::shared_ptr< BamAlignment > > > bamAlignmentPtrsPerBam(this->m_bam_reader_ptrs.size());
+		std::vector< std::future< void > > fetchFutures;
+		for (size_t i = 1; i < this->m_bam_reader_ptrs.size(); ++i)
+		{
+			if (this->m_thread_pool.size() > 0)
+			{
+				fetchFutures.emplace_back(this->m_thread_pool.enqueue(&GraphProcessor::getAlignmentsInRegionFromBam, this, this->m_bam_reader_ptrs[i], std::ref(bamAlignmentPtrsPerBam[i]), std::cref(regionPtrs), getFlankingUnalignedReads));
+			}
+			else
+			{
+				getAlignmentsInRegionFromBam(this->m_bam_reader_ptrs[i], bamAlignmentPtrsPerBam[i], regionPtrs, getFlankingUnalignedReads);
+			}
+		}
+		if (!this->m_bam_reader_ptrs.empty())
+		{
+			getAlignmentsInRegionFromBam(this->m_bam_reader_ptrs[0], bamAlignmentPtrsPerBam[0], regionPtrs, getFlankingUnalignedReads);
+		}
+		for (auto& fetchFuture : fetchFutures)
+		{
+			fetchFuture.get();
+		}
+
+		// reads of different bams are different reads so the per bam results are concatenated in bam order
+		bamAlignmentPtrs.clear();
+		size_t readCount = 0;
+		for (auto& bamResultPtrs : bamAlignmentPtrsPerBam)
+		{
+			readCount += bamResultPtrs.size();
+		}
+		bamAlignmentPtrs.reserve(readCount);
+		for (auto& bamResultPtrs : bamAlignmentPtrsPerBam)
+		{
+			bamAlignmentPtrs.insert(bamAlignmentPtrs.end(), bamResultPtrs.begin(), bamResultPtrs.end());
+		}
+		downsampleAlignments(bamAlignmentPtrs, sampleDownsampleFractions);
+	}
+
+	/*
+	 * Keeps at most m_max_depth reads of every sample. The kept reads are the ones with the smallest scrambled read ids
+	 * so the same reads are picked on every run and in every shard, the kept reads stay in their fetch order.
+	 */
+	void GraphProcessor::downsampleAlignments(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< float >& sampleDownsampleFractions)
+	{
+		sampleDownsampleFractions.assign(this->m_sample_count, 1.0f);
+		if (this->m_max_depth == 0)
+		{
+			return;
+		}
+		std::vector< std::vector< uint32_t > > sampleReadIndices(this->m_sample_count);
+		for (uint32_t i = 0; i < bamAlignmentPtrs.size(); ++i)
+		{
+			sampleReadIndices[bamAlignmentPtrs[i]->getSamplePtr()->getIndex()].emplace_back(i);
+		}
+		// read ids of names that share a prefix are close together, the finalizer spreads them before they are ranked
+		auto getPriority = [&bamAlignmentPtrs](uint32_t readIndex)
+		{
+			uint64_t priority = bamAlignmentPtrs[readIndex]->getReadID();
+			priority = (priority ^ (priority >> 30)) * 0xbf58476d1ce4e5b9ULL;
+			priority = (priority ^ (priority >> 27)) * 0x94d049bb133111ebULL;
+			return priority ^ (priority >> 31);
+		};
+		// ties fall back to the read index so the choice never depends on the selection algorithm
+		auto isLess = [&getPriority](uint32_t a, uint32_t b)
+		{
+			uint64_t priorityA = getPriority(a);
+			uint64_t priorityB = getPriority(b);
+			return (priorityA != priorityB) ? priorityA < priorityB : a < b;
+		};
+		std::vector< bool > isDropped(bamAlignmentPtrs.size(), false);
+		bool anyDropped = false;
+		for (uint32_t sampleIndex = 0; sampleIndex < this->m_sample_count; ++sampleIndex)
+		{
+			auto& readIndices = sampleReadIndices[sampleIndex];
+			if (readIndices.size() <= this->m_max_depth)
+			{
+				continue;
+			}
+			std::nth_element(readIndices.begin(), readIndices.begin() + this->m_max_depth, readIndices.end(), isLess);
+			for (auto iter = readIndices.begin() + this->m_max_depth; iter != readIndices.end(); ++iter)
+			{
+				isDropped[*iter] = true;
+			}
+			sampleDownsampleFractions[sampleIndex] = (float)this->m_max_depth / readIndices.size();
+			anyDropped = true;
+		}
+		if (!anyDropped)
+		{
+			return;
+		}
+		size_t keptCount = 0;
+		for (size_t i = 0; i < bamAlignmentPtrs.size(); ++i)
+		{
+			if (!isDropped[i])
+			{
+				bamAlignmentPtrs[keptCount++] = bamAlignmentPtrs[i];
+			}
+		}
+		bamAlignmentPtrs.resize(keptCount);
+	}
+
+	/*
+	 * Fetches the cluster's reads (and the flanks) from one bam into bamAlignmentPtrs. Overlapping regions
+	 * return the same read more than once so only the first fetch of each read is kept, in fetch order.
+	 */
+	void GraphProcessor::getAlignmentsInRegionFromBam(IAlignmentReader::SharedPtr bamReaderPtr, std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, const std::vector< Region::SharedPtr >& regionPtrs, bool getFlankingUnalignedReads)
 	{
 		std::vector< std::shared_ptr< BamAlignment > > bamAlignmentPtrsTmp;
+		if (!regionPtrs.empty())
+		{
+			// clusters move forward along the chromosome so reads before this cluster's flank won't be asked for again
+			auto regionPtr = regionPtrs.front();
+			position evictionPosition = (regionPtr->getStartPosition() > this->m_flanking_padding) ? regionPtr->getStartPosition() - this->m_flanking_padding : 0;
+			bamReaderPtr->evictAlignmentsBefore(regionPtr->getReferenceID(), evictionPosition);
+		}
 		for (auto iter = regionPtrs.begin(); iter != regionPtrs.end(); ++iter)
 		{
 			auto regionPtr = (*iter);
-			for (auto bamReaderPtr : this->m_bam_reader_ptrs)
+			if (iter == regionPtrs.begin() && getFlankingUnalignedReads)
 			{
-				if (iter == regionPtrs.begin() && getFlankingUnalignedReads)
-				{
-					auto flankingRegionPtr = std::make_shared< Region >(regionPtr->getReferenceID(), regionPtr->getStartPosition() - this->m_flanking_padding, regionPtr->getStartPosition(), regionPtr->getBased());
-					bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, flankingRegionPtr, false, false);
-				}
-				bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, regionPtr, false, false);
-				if (iter == regionPtrs.end() && getFlankingUnalignedReads)
-				{
-					auto flankingRegionPtr = std::make_shared< Region >(regionPtr->getReferenceID(), regionPtr->getEndPosition(), regionPtr->getEndPosition() + this->m_flanking_padding, regionPtr->getBased());
-					bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, flankingRegionPtr, false, false);
-				}
+				auto flankingRegionPtr = std::make_shared< Region >(regionPtr->getReferenceID(), regionPtr->getStartPosition() - this->m_flanking_padding, regionPtr->getStartPosition(), regionPtr->getBased());
+				bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, flankingRegionPtr, false, false);
+			}
+			bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, regionPtr, false, false);
+			if (iter == regionPtrs.end() && getFlankingUnalignedReads)
+			{
+				auto flankingRegionPtr = std::make_shared< Region >(regionPtr->getReferenceID(), regionPtr->getEndPosition(), regionPtr->getEndPosition() + this->m_flanking_padding, regionPtr->getBased());
+				bamReaderPtr->fetchBamAlignmentPtrsInRegion(bamAlignmentPtrsTmp, flankingRegionPtr, false, false);
 			}
 		}
 
-		// make sure the reads only appear in bamAlignmentPtrs once
+		// order the fetches by read id, the first fetch of each read stays in front of its copies. Names are only compared
+		// when two ids are equal which is almost always a copy of the same read, but keeps distinct reads with colliding ids apart
+		std::vector< uint32_t > sortedIndices(bamAlignmentPtrsTmp.size());
+		for (uint32_t i = 0; i < sortedIndices.size(); ++i)
+		{
+			sortedIndices[i] = i;
+		}
+		auto isLess = [&bamAlignmentPtrsTmp](uint32_t a, uint32_t b)
+		{
+			auto& alignmentA = bamAlignmentPtrsTmp[a];
+			auto& alignmentB = bamAlignmentPtrsTmp[b];
+			if (alignmentA->getReadID() != alignmentB->getReadID())
+			{
+				return alignmentA->getReadID() < alignmentB->getReadID();
+			}
+			int nameComparison = alignmentA->Name.compare(alignmentB->Name);
+			return (nameComparison != 0) ? nameComparison < 0 : alignmentA->IsFirstMate() < alignmentB->IsFirstMate();
+		};
+		std::stable_sort(sortedIndices.begin(), sortedIndices.end(), isLess);
+		std::vector< bool > isDuplicate(bamAlignmentPtrsTmp.size(), false);
+		for (size_t i = 1; i < sortedIndices.size(); ++i)
+		{
+			isDuplicate[sortedIndices[i]] = !isLess(sortedIndices[i - 1], sortedIndices[i]);
+		}
 		bamAlignmentPtrs.clear();
-		std::unordered_set< std::string > bamIDTracker;
-		for (auto bamAlignmentPtr : bamAlignmentPtrsTmp)
+		for (size_t i = 0; i < bamAlignmentPtrsTmp.size(); ++i)
 		{
-			std::string bamID = bamAlignmentPtr->Name + std::to_string(bamAlignmentPtr->IsFirstMate());
-			if (bamIDTracker.find(bamID) == bamIDTracker.end())
+			if (!isDuplicate[i])
 			{
-				bamAlignmentPtrs.emplace_back(bamAlignmentPtr);
-				bamIDTracker.emplace(bamID);
+				bamAlignmentPtrs.emplace_back(bamAlignmentPtrsTmp[i]);
 			}
 		}
 	}
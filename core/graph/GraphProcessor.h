@@ -5,7 +5,7 @@
 #include "core/region/Region.h"
 #include "core/reference/FastaReference.h"
 #include "core/vcf/VCFReader.h"
-#include "core/bam/BamReader.h"
+#include "core/bam/IAlignmentReader.h"
 #include "core/util/ThreadPool.hpp"
 #include "core/util/GraphPrinter.h"
 #include "Graph.h"
@@ -29,19 +29,25 @@ namespace graphite
 	{
 	public:
 		typedef std::shared_ptr< GraphProcessor > SharedPtr;
-		GraphProcessor(FastaReference::SharedPtr fastaReferencePtr, const std::vector< BamReader::SharedPtr >& bamReaderPtrs, const std::vector< VCFReader::SharedPtr >& vcfReaderPtrs, uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph);
+		GraphProcessor(FastaReference::SharedPtr fastaReferencePtr, const std::vector< IAlignmentReader::SharedPtr >& bamReaderPtrs, const std::vector< VCFReader::SharedPtr >& vcfReaderPtrs, uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph, uint32_t threadCount, uint32_t maxDepth);
 		~GraphProcessor();
 
 		void processVariants();
+		static uint32_t getGraphSpacing(const std::vector< IAlignmentReader::SharedPtr >& bamReaderPtrs);
 
 	private:
+		void getNextVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing);
+		void mergeIdenticalAlleles(std::vector< Variant::SharedPtr >& variantPtrs);
+		bool isVariantBefore(Variant::SharedPtr variantPtr, Variant::SharedPtr otherVariantPtr);
+		void prefetchVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing);
 		void adjudicateVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing);
 		void adjudicateVariants2(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t graphSpacing);
-        void getAlignmentsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< Region::SharedPtr > regionPtrs, bool getFlankingUnalignedReads);
+        void getAlignmentsInRegion(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< float >& sampleDownsampleFractions, std::vector< Region::SharedPtr > regionPtrs, bool getFlankingUnalignedReads);
+		void getAlignmentsInRegionFromBam(IAlignmentReader::SharedPtr bamReaderPtr, std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, const std::vector< Region::SharedPtr >& regionPtrs, bool getFlankingUnalignedReads);
+		void downsampleAlignments(std::vector< std::shared_ptr< BamAlignment > >& bamAlignmentPtrs, std::vector< float >& sampleDownsampleFractions);
 		FastaReference::SharedPtr m_fasta_reference_ptr;
-		std::vector< BamReader::SharedPtr > m_bam_reader_ptrs;
+		std::vector< IAlignmentReader::SharedPtr > m_bam_reader_ptrs;
 		std::vector< VCFReader::SharedPtr > m_vcf_reader_ptrs;
-		std::unordered_map< std::string, Sample::SharedPtr > m_bam_sample_ptrs;
 		uint32_t m_flanking_padding;
 		uint32_t m_match_value;
 		uint32_t m_mismatch_value;
@@ -49,6 +55,10 @@ namespace graphite
 		uint32_t m_gap_extension_value;
 		ThreadPool m_thread_pool;
 		bool m_print_graphs;
+		uint32_t m_max_depth; // reads kept per sample and cluster, 0 keeps every read
+		uint32_t m_sample_count;
+		std::vector< std::vector< Variant::SharedPtr > > m_pending_variant_ptrs; // the next cluster of every vcf reader
+		std::unordered_map< std::string, uint32_t > m_chromosome_ranks; // chromosomes in the order they are first seen, the vcfs share this order
 	};
 }
 
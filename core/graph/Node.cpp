@@ -159,11 +159,11 @@ namespace graphite
 		return nodePtr;
 	}
 
-	void Node::incrementScoreCount(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, int score)
+	void Node::incrementScoreCount(uint32_t readIndex, uint32_t sampleIndex, bool isForwardStrand, int score)
 	{
 		if (this->m_allele_ptr != nullptr)
 		{
-			this->m_allele_ptr->incrementScoreCount(bamAlignmentPtr, samplePtr, isForwardStrand, score);
+			this->m_allele_ptr->incrementScoreCount(readIndex, sampleIndex, isForwardStrand, score);
 		}
 		// bool nodeSkipped = true;
 
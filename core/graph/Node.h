@@ -45,7 +45,7 @@ namespace graphite
 
 		void addOverlappingAllelePtr(Allele::SharedPtr allelePtr);
 		std::unordered_set< Allele::SharedPtr > getOverlappingAllelePtrs();
-		void incrementScoreCount(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, int score);
+		void incrementScoreCount(uint32_t readIndex, uint32_t sampleIndex, bool isForwardStrand, int score);
 		std::string getOriginalSequence();
 		uint32_t getOriginalSequenceSize();
 		void setAllelePtr(Allele::SharedPtr allelePtr) { this->m_allele_ptr = allelePtr; }
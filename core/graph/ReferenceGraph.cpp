@@ -13,8 +13,17 @@ namespace graphite
 	{
 	}
 
-	float ReferenceGraph::adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue)
+	void ReferenceGraph::setReadCount(uint32_t readCount)
 	{
+		this->m_aligned_read_indices.resize(readCount);
+	}
+
+	float ReferenceGraph::adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue)
+	{
+		if (this->m_aligned_read_indices.testAndSet(readIndex))
+		{
+			return 0;
+		}
 		gssw_sse2_disable();
 		int8_t* nt_table = gssw_create_nt_table();
 		int8_t* mat = gssw_create_score_matrix(matchValue, mismatchValue);
@@ -38,15 +47,6 @@ namespace graphite
 
 	float ReferenceGraph::processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue)
 	{
-		std::string alignmentName = bamAlignmentPtr->Name + std::to_string(bamAlignmentPtr->IsFirstMate());
-		{
-			std::lock_guard< std::mutex > l(m_aligned_read_names_mutex);
-			if (this->m_aligned_read_names.find(alignmentName) != this->m_aligned_read_names.end())
-			{
-				return 0;
-			}
-			this->m_aligned_read_names.emplace(alignmentName);
-		}
 		std::vector< std::tuple< Node*, uint32_t > > nodePtrScoreTuples;
 		uint32_t prefixMatch = 0;
 		uint32_t suffixMatch = 0;
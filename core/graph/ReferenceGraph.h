@@ -4,6 +4,7 @@
 #include "core/util/Noncopyable.hpp"
 #include "core/region/Region.h"
 #include "core/reference/FastaReference.h"
+#include "core/util/AtomicBitmap.hpp"
 
 #include "Node.h"
 
@@ -23,15 +24,15 @@ namespace graphite
 		ReferenceGraph(const std::string& refSequence, position startPosition);
 		~ReferenceGraph();
 
-float adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue);
+		void setReadCount(uint32_t readCount);
+		float adjudicateAlignment(std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, uint32_t readIndex, Sample::SharedPtr samplePtr, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue);
 
 	private:
 		float processTraceback(gssw_graph_mapping* graphMapping, std::shared_ptr< BamTools::BamAlignment > bamAlignmentPtr, Sample::SharedPtr samplePtr, bool isForwardStrand, uint32_t  matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t  gapExtensionValue);
 
 		Node::SharedPtr m_node;
 		Region::SharedPtr m_region_ptr;
-		std::unordered_set< std::string > m_aligned_read_names;
-		std::mutex m_aligned_read_names_mutex;
+		AtomicBitmap m_aligned_read_indices; // indexed by the read's dense index within the cluster
 
 	};
 
@@ -1,6 +1,7 @@
 #include "Region.h"
 
 #include "core/util/Utility.h"
+#include "core/util/Tokenizer.hpp"
 
 #include <vector>
 #include <string>
@@ -16,23 +17,18 @@ namespace graphite
 		m_end_position(0),
 		m_based(based)
 	{
-		std::vector< std::string > chromWithPositionComponents;
-		std::vector< std::string > positionComponents;
-		split(regionString, ':', chromWithPositionComponents);
+		std::vector< StringView > chromWithPositionComponents;
+		std::vector< StringView > positionComponents;
+		Tokenizer::split(StringView(regionString.data(), regionString.size()), ':', chromWithPositionComponents);
 
-		if (chromWithPositionComponents.size() == 0)
+		this->m_reference_id = chromWithPositionComponents[0].toString();
+		if (chromWithPositionComponents.size() > 1)
 		{
-			this->m_reference_id = regionString;
-		}
-		else
-		{
-			this->m_reference_id = chromWithPositionComponents[0];
-			split(chromWithPositionComponents[1], '-', positionComponents);
+			Tokenizer::split(chromWithPositionComponents[1], '-', positionComponents);
 
-			if (positionComponents.size() == 2)
+			if (positionComponents.size() == 2 && (!Tokenizer::parseUnsigned(positionComponents[0], this->m_start_position) || !Tokenizer::parseUnsigned(positionComponents[1], this->m_end_position)))
 			{
-				m_start_position = std::stol(positionComponents[0]);
-				m_end_position = std::stol(positionComponents[1]);
+				throw std::invalid_argument("Region format is invalid");
 			}
 		}
 		if (this->m_start_position > this->m_end_position || regionString.size() == 0)
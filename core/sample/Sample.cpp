@@ -5,7 +5,8 @@ namespace graphite
 	Sample::Sample(const std::string& sampleName, const std::string& readGroup, const std::string& samplePath) :
 		m_sample_name(sampleName),
 		m_sample_readgroup(readGroup),
-		m_sample_path(samplePath)
+		m_sample_path(samplePath),
+		m_sample_index(0)
 	{
 	}
 
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <memory>
+#include <stdint.h>
 
 #include "core/util/Noncopyable.hpp"
 
@@ -20,11 +21,14 @@ namespace graphite
 		std::string getName();
 		std::string getReadgroup();
 		std::string getPath();
+		uint32_t getIndex() { return m_sample_index; }
+		void setIndex(uint32_t sampleIndex) { m_sample_index = sampleIndex; }
 
 	private:
 		std::string m_sample_name;
 		std::string m_sample_readgroup;
 		std::string m_sample_path;
+		uint32_t m_sample_index; // dense index shared by every read group of a sample, used to key allele counts
 	};
 }
 
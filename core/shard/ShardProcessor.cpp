@@ -0,0 +1,425 @@
+#include "ShardProcessor.h"
+
+#include "core/reference/FastaReference.h"
+#include "core/bam/IAlignmentReader.h"
+#include "core/vcf/VCFReader.h"
+#include "core/vcf/VCFWriter.h"
+#include "core/graph/GraphProcessor.h"
+#include "core/util/LineReader.h"
+#include "core/util/Tokenizer.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <future>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace graphite
+{
+	ShardProcessor::ShardProcessor(const std::string& fastaPath, const std::vector< std::string >& bamPaths, const std::vector< std::string >& vcfPaths, const std::string& outputDirectory, Region::SharedPtr regionPtr, uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph, bool prefetch, bool sweep, uint32_t decompressionThreadCount, uint32_t maxDepth, uint32_t bgzipThreadCount) :
+		m_fasta_path(fastaPath),
+		m_bam_paths(bamPaths),
+		m_vcf_paths(vcfPaths),
+		m_output_directory(outputDirectory),
+		m_region_ptr(regionPtr),
+		m_match_value(matchValue),
+		m_mismatch_value(mismatchValue),
+		m_gap_open_value(gapOpenValue),
+		m_gap_extension_value(gapExtensionValue),
+		m_print_graphs(printGraph),
+		m_prefetch(prefetch),
+		m_sweep(sweep),
+		m_decompression_thread_count(decompressionThreadCount),
+		m_max_depth(maxDepth),
+		m_bgzip_thread_count(bgzipThreadCount)
+	{
+	}
+
+	ShardProcessor::~ShardProcessor()
+	{
+	}
+
+	void ShardProcessor::process(uint32_t shardCount, uint32_t threadCount)
+	{
+		getSampleNames(); // once, before the shards start
+		std::vector< std::vector< Region::SharedPtr > > shards;
+		if (shardCount > 1)
+		{
+			shards = partition(shardCount);
+		}
+
+		// a single shard writes straight into the output directory
+		if (shards.size() <= 1)
+		{
+			std::vector< Region::SharedPtr > regionPtrs;
+			if (this->m_region_ptr != nullptr)
+			{
+				regionPtrs.emplace_back(this->m_region_ptr);
+			}
+			processShard(regionPtrs, this->m_output_directory, threadCount, true);
+			return;
+		}
+
+		// at most threadCount shards run at once, each runner takes the next shard in input order so the merge never waits
+		// on a shard that hasn't been started. Shards write plain text and only the merged outputs are compressed or bcf
+		uint32_t runnerCount = std::min< uint32_t >(std::max< uint32_t >(1, threadCount), shards.size());
+		uint32_t shardThreadCount = std::max< uint32_t >(1, threadCount / runnerCount);
+		std::vector< std::promise< void > > shardPromises(shards.size());
+		std::vector< std::future< void > > shardFutures;
+		for (auto& shardPromise : shardPromises)
+		{
+			shardFutures.emplace_back(shardPromise.get_future());
+		}
+		std::atomic< uint32_t > nextShardIndex(0);
+		std::vector< std::thread > runnerThreads;
+		for (uint32_t i = 0; i < runnerCount; ++i)
+		{
+			runnerThreads.emplace_back([this, &shards, &shardPromises, &nextShardIndex, shardThreadCount]()
+			{
+				uint32_t shardIndex;
+				while ((shardIndex = nextShardIndex++) < shards.size())
+				{
+					try
+					{
+						std::string shardOutputDirectory = getShardOutputDirectory(shardIndex);
+						mkdir(shardOutputDirectory.c_str(), 0755);
+						processShard(shards[shardIndex], shardOutputDirectory, shardThreadCount, false);
+						shardPromises[shardIndex].set_value();
+					}
+					catch (...)
+					{
+						shardPromises[shardIndex].set_exception(std::current_exception());
+					}
+				}
+			});
+		}
+
+		resetOutputs();
+
+		// stream each shard into the final outputs as soon as it and every shard before it has finished
+		std::exception_ptr shardExceptionPtr = nullptr;
+		for (uint32_t i = 0; i < shardFutures.size(); ++i)
+		{
+			try
+			{
+				shardFutures[i].get();
+			}
+			catch (...)
+			{
+				shardExceptionPtr = std::current_exception();
+				nextShardIndex = shards.size(); // the runners stop after their current shard
+				break;
+			}
+			appendShardOutput(getShardOutputDirectory(i), i == 0);
+		}
+		for (auto& runnerThread : runnerThreads)
+		{
+			runnerThread.join();
+		}
+		if (shardExceptionPtr != nullptr)
+		{
+			std::rethrow_exception(shardExceptionPtr);
+		}
+		finishOutputs();
+	}
+
+	/*
+	 * Returns the regions of each shard. Shards hold consecutive variants in file order and only end where the
+	 * next variant is on another chromosome or at least a graph spacing away so no cluster is split between shards.
+	 * The input VCFs are expected to share the same chromosome order.
+	 */
+	std::vector< std::vector< Region::SharedPtr > > ShardProcessor::partition(uint32_t shardCount)
+	{
+		std::vector< IAlignmentReader::SharedPtr > bamReaderPtrs;
+		for (auto bamPath : this->m_bam_paths)
+		{
+			bamReaderPtrs.emplace_back(IAlignmentReader::openAlignmentReader(bamPath, this->m_fasta_path, this->m_decompression_thread_count));
+		}
+		uint32_t graphSpacing = GraphProcessor::getGraphSpacing(bamReaderPtrs);
+
+		// collect the positions of every variant grouped by chromosome, chromosomes are kept in the order they first appear
+		std::vector< std::string > chromosomes;
+		std::unordered_map< std::string, std::vector< position > > chromosomePositions;
+		size_t totalVariantCount = 0;
+		auto addPosition = [&](const std::string& chrom, position pos)
+		{
+			if (this->m_region_ptr != nullptr && (this->m_region_ptr->getReferenceID() != chrom || pos < this->m_region_ptr->getStartPosition() || this->m_region_ptr->getEndPosition() < pos))
+			{
+				return;
+			}
+			auto iter = chromosomePositions.find(chrom);
+			if (iter == chromosomePositions.end())
+			{
+				chromosomes.emplace_back(chrom);
+				iter = chromosomePositions.emplace(chrom, std::vector< position >()).first;
+			}
+			iter->second.emplace_back(pos);
+			++totalVariantCount;
+		};
+		for (auto vcfPath : this->m_vcf_paths)
+		{
+			if (VCFFileWriter::isBCFPath(vcfPath))
+			{
+				// bcf records already hold the chromosome id and the zero based position
+				htsFile* bcfFilePtr = hts_open(vcfPath.c_str(), "rb");
+				bcf_hdr_t* bcfHeaderPtr = (bcfFilePtr != nullptr) ? bcf_hdr_read(bcfFilePtr) : nullptr;
+				if (bcfHeaderPtr != nullptr)
+				{
+					bcf1_t* bcfRecordPtr = bcf_init();
+					while (bcf_read(bcfFilePtr, bcfHeaderPtr, bcfRecordPtr) >= 0)
+					{
+						addPosition(bcf_hdr_id2name(bcfHeaderPtr, bcfRecordPtr->rid), bcfRecordPtr->pos + 1);
+					}
+					bcf_destroy(bcfRecordPtr);
+					bcf_hdr_destroy(bcfHeaderPtr);
+				}
+				if (bcfFilePtr != nullptr)
+				{
+					hts_close(bcfFilePtr);
+				}
+				continue;
+			}
+			LineReader lineReader(vcfPath);
+			StringView line;
+			while (lineReader.getNextLine(line))
+			{
+				if (line.size() == 0 || line[0] == '#')
+				{
+					continue;
+				}
+				const char* lineEnd = line.data() + line.size();
+				const char* chromEnd = Tokenizer::findDelimiter(line.data(), lineEnd, '\t');
+				if (chromEnd == lineEnd)
+				{
+					continue;
+				}
+				const char* posEnd = Tokenizer::findDelimiter(chromEnd + 1, lineEnd, '\t');
+				position pos = 0;
+				Tokenizer::parseUnsigned(StringView(chromEnd + 1, posEnd - (chromEnd + 1)), pos);
+				addPosition(std::string(line.data(), chromEnd - line.data()), pos);
+			}
+		}
+
+		std::vector< std::vector< Region::SharedPtr > > shards;
+		if (totalVariantCount == 0)
+		{
+			return shards;
+		}
+		size_t shardVariantTarget = (totalVariantCount + shardCount - 1) / shardCount;
+		size_t shardVariantCount = 0;
+		shards.emplace_back();
+		for (auto chrom : chromosomes)
+		{
+			auto& positions = chromosomePositions[chrom];
+			std::sort(positions.begin(), positions.end());
+			position regionStart = positions[0];
+			for (size_t i = 0; i < positions.size(); ++i)
+			{
+				++shardVariantCount;
+				bool isChromosomeEnd = (i + 1 == positions.size());
+				bool closeShard = shardVariantCount >= shardVariantTarget && shards.size() < shardCount && (isChromosomeEnd || (positions[i + 1] - positions[i]) >= graphSpacing);
+				if (isChromosomeEnd || closeShard)
+				{
+					shards.back().emplace_back(std::make_shared< Region >(chrom, regionStart, positions[i], Region::BASED::ONE));
+					if (!isChromosomeEnd)
+					{
+						regionStart = positions[i + 1];
+					}
+				}
+				if (closeShard)
+				{
+					shards.emplace_back();
+					shardVariantCount = 0;
+				}
+			}
+		}
+		if (shards.back().empty())
+		{
+			shards.pop_back();
+		}
+		return shards;
+	}
+
+	/*
+	 * Adjudicates the variants inside regionPtrs (or every variant if regionPtrs is empty) with its own
+	 * reference, bam and vcf handles and writes the annotated vcfs into shardOutputDirectory. Only a final
+	 * output is written in the input's binary format or bgzipped, shards that are merged later are plain text.
+	 */
+	void ShardProcessor::processShard(const std::vector< Region::SharedPtr >& regionPtrs, const std::string& shardOutputDirectory, uint32_t threadCount, bool finalOutput)
+	{
+		auto fastaReferencePtr = std::make_shared< FastaReference >(this->m_fasta_path);
+
+		// create bam readers
+		std::vector< IAlignmentReader::SharedPtr > bamReaderPtrs;
+		for (auto bamPath : this->m_bam_paths)
+		{
+			auto bamReaderPtr = IAlignmentReader::openAlignmentReader(bamPath, this->m_fasta_path, this->m_decompression_thread_count);
+			if (this->m_prefetch)
+			{
+				bamReaderPtr->enablePrefetch();
+			}
+			if (this->m_sweep)
+			{
+				bamReaderPtr->enableSweep();
+			}
+			bamReaderPtrs.emplace_back(bamReaderPtr);
+		}
+
+		// every sample's dense index is its place in the run's sample order, read groups that belong to the same sample share the index.
+		// The writers plan their columns from the ordered samples, so every shard's records line up under the first shard's header
+		auto& sampleNames = getSampleNames();
+		std::unordered_map< std::string, uint32_t > sampleIndices;
+		for (uint32_t i = 0; i < sampleNames.size(); ++i)
+		{
+			sampleIndices.emplace(sampleNames[i], i);
+		}
+		std::vector< Sample::SharedPtr > bamSamplePtrs;
+		for (auto bamReaderPtr : bamReaderPtrs)
+		{
+			for (auto samplePtr : bamReaderPtr->getSamplePtrs())
+			{
+				samplePtr->setIndex(sampleIndices[samplePtr->getName()]);
+				bamSamplePtrs.emplace_back(samplePtr);
+			}
+		}
+		std::stable_sort(bamSamplePtrs.begin(), bamSamplePtrs.end(), [](const Sample::SharedPtr& a, const Sample::SharedPtr& b) { return a->getIndex() < b->getIndex(); });
+
+		// create VCF readers and writers
+		std::vector< VCFReader::SharedPtr > vcfReaderPtrs;
+		for (auto vcfPath : this->m_vcf_paths)
+		{
+			auto vcfWriterPtr = std::make_shared< VCFWriter >(vcfPath, bamSamplePtrs, shardOutputDirectory, finalOutput, finalOutput ? this->m_bgzip_thread_count : 0);
+			if (this->m_max_depth > 0)
+			{
+				vcfWriterPtr->enableDownsampleFraction(); // before the reader writes the header
+			}
+			auto vcfReaderPtr = std::make_shared< VCFReader >(vcfPath, bamSamplePtrs, regionPtrs, vcfWriterPtr);
+			if (this->m_prefetch)
+			{
+				vcfReaderPtr->enablePrefetch();
+			}
+			vcfReaderPtrs.emplace_back(vcfReaderPtr);
+		}
+
+		auto graphProcessorPtr = std::make_shared< GraphProcessor >(fastaReferencePtr, bamReaderPtrs, vcfReaderPtrs, this->m_match_value, this->m_mismatch_value, this->m_gap_open_value, this->m_gap_extension_value, this->m_print_graphs, threadCount, this->m_max_depth);
+		graphProcessorPtr->processVariants();
+	}
+
+	/*
+	 * Truncates the final outputs so shards can be appended to them, compressed and bcf outputs are opened
+	 * for the whole merge and finished by finishOutputs.
+	 */
+	void ShardProcessor::resetOutputs()
+	{
+		this->m_output_writer_ptrs.clear();
+		for (auto vcfPath : this->m_vcf_paths)
+		{
+			std::string outputPath = VCFWriter::getOutputPath(this->m_output_directory, vcfPath, true, this->m_bgzip_thread_count > 0);
+			if (this->m_bgzip_thread_count > 0 || VCFFileWriter::isBCFPath(outputPath))
+			{
+				this->m_output_writer_ptrs.emplace_back(std::make_shared< VCFFileWriter >(outputPath, this->m_bgzip_thread_count));
+			}
+			else
+			{
+				std::ofstream outFile(outputPath, std::ios::trunc);
+				this->m_output_writer_ptrs.emplace_back(nullptr);
+			}
+		}
+	}
+
+	/*
+	 * Appends a finished shard's vcfs to the final outputs and removes the shard files.
+	 * Only the first shard's header is kept.
+	 */
+	void ShardProcessor::appendShardOutput(const std::string& shardOutputDirectory, bool includeHeader)
+	{
+		for (size_t i = 0; i < this->m_vcf_paths.size(); ++i)
+		{
+			std::string shardPath = VCFWriter::getOutputPath(shardOutputDirectory, this->m_vcf_paths[i], false, false);
+			if (this->m_output_writer_ptrs[i] != nullptr)
+			{
+				// compressed and bcf outputs are fed line by line so every record is indexed or encoded
+				LineReader lineReader(shardPath);
+				StringView line;
+				while (lineReader.getNextLine(line))
+				{
+					if (includeHeader || line.empty() || line[0] != '#')
+					{
+						this->m_output_writer_ptrs[i]->writeLine(line.data(), line.size());
+					}
+				}
+			}
+			else
+			{
+				std::ifstream inFile(shardPath);
+				std::ofstream outFile(VCFWriter::getOutputPath(this->m_output_directory, this->m_vcf_paths[i], true, false), std::ios::app);
+				if (!includeHeader)
+				{
+					std::string line;
+					while (inFile.peek() == '#' && std::getline(inFile, line)) {}
+				}
+				if (inFile.peek() != std::ifstream::traits_type::eof())
+				{
+					outFile << inFile.rdbuf();
+				}
+			}
+			std::remove(shardPath.c_str());
+		}
+		rmdir(shardOutputDirectory.c_str());
+	}
+
+	/*
+	 * Writes the end of the compressed outputs and their indices once every shard is appended.
+	 */
+	void ShardProcessor::finishOutputs()
+	{
+		for (auto outputWriterPtr : this->m_output_writer_ptrs)
+		{
+			if (outputWriterPtr != nullptr)
+			{
+				outputWriterPtr->close();
+			}
+		}
+		this->m_output_writer_ptrs.clear();
+	}
+
+	/*
+	 * The samples of the bams in the order the bams were given and then in the order of each header's read groups.
+	 * It only depends on the bam headers, so worker processes that load it for themselves get the same order.
+	 */
+	const std::vector< std::string >& ShardProcessor::getSampleNames()
+	{
+		std::call_once(this->m_sample_names_flag, &ShardProcessor::loadSampleNames, this);
+		return this->m_sample_names;
+	}
+
+	void ShardProcessor::loadSampleNames()
+	{
+		std::unordered_set< std::string > sampleNames;
+		for (auto bamPath : this->m_bam_paths)
+		{
+			auto bamReaderPtr = IAlignmentReader::openAlignmentReader(bamPath, this->m_fasta_path, this->m_decompression_thread_count);
+			for (auto samplePtr : bamReaderPtr->getSamplePtrs())
+			{
+				if (sampleNames.emplace(samplePtr->getName()).second)
+				{
+					this->m_sample_names.emplace_back(samplePtr->getName());
+				}
+			}
+		}
+	}
+
+	std::string ShardProcessor::getShardOutputDirectory(uint32_t shardIndex)
+	{
+		return this->m_output_directory + "/graphite_shard_" + std::to_string(shardIndex);
+	}
+}
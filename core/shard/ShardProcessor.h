@@ -0,0 +1,61 @@
+#ifndef GRAPHITE_SHARDPROCESSOR_H
+#define GRAPHITE_SHARDPROCESSOR_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/region/Region.h"
+#include "core/vcf/VCFFileWriter.h"
+
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace graphite
+{
+	/*
+	 * Splits the input VCFs into region shards with roughly the same number of variants,
+	 * runs every shard with its own readers and workers and merges the shard outputs back
+	 * into one VCF per input in input order.
+	 */
+	class ShardProcessor : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< ShardProcessor > SharedPtr;
+		ShardProcessor(const std::string& fastaPath, const std::vector< std::string >& bamPaths, const std::vector< std::string >& vcfPaths, const std::string& outputDirectory, Region::SharedPtr regionPtr, uint32_t matchValue, uint32_t mismatchValue, uint32_t gapOpenValue, uint32_t gapExtensionValue, bool printGraph, bool prefetch, bool sweep, uint32_t decompressionThreadCount, uint32_t maxDepth, uint32_t bgzipThreadCount);
+		~ShardProcessor();
+
+		void process(uint32_t shardCount, uint32_t threadCount);
+
+		std::vector< std::vector< Region::SharedPtr > > partition(uint32_t shardCount);
+		void processShard(const std::vector< Region::SharedPtr >& regionPtrs, const std::string& shardOutputDirectory, uint32_t threadCount, bool finalOutput);
+		void resetOutputs();
+		void appendShardOutput(const std::string& shardOutputDirectory, bool includeHeader);
+		void finishOutputs();
+		std::string getShardOutputDirectory(uint32_t shardIndex);
+		const std::vector< std::string >& getSampleNames();
+
+	private:
+		void loadSampleNames();
+
+		std::string m_fasta_path;
+		std::vector< std::string > m_bam_paths;
+		std::vector< std::string > m_vcf_paths;
+		std::string m_output_directory;
+		Region::SharedPtr m_region_ptr;
+		uint32_t m_match_value;
+		uint32_t m_mismatch_value;
+		uint32_t m_gap_open_value;
+		uint32_t m_gap_extension_value;
+		bool m_print_graphs;
+		bool m_prefetch;
+		bool m_sweep;
+		uint32_t m_decompression_thread_count;
+		uint32_t m_max_depth;
+		uint32_t m_bgzip_thread_count;
+		std::vector< VCFFileWriter::SharedPtr > m_output_writer_ptrs; // the compressed final outputs while shards are merged
+		std::vector< std::string > m_sample_names; // every bam sample in column order, the same in every shard and worker
+		std::once_flag m_sample_names_flag;
+	};
+}
+
+#endif //GRAPHITE_SHARDPROCESSOR_H
@@ -0,0 +1,49 @@
+#ifndef GRAPHITE_ATOMICBITMAP_HPP
+#define GRAPHITE_ATOMICBITMAP_HPP
+
+#include "Noncopyable.hpp"
+
+#include <atomic>
+#include <memory>
+#include <stdint.h>
+
+namespace graphite
+{
+	/*
+	 * Fixed size bitmap whose bits can be claimed concurrently without a lock.
+	 * resize is not thread safe and should happen before the workers start.
+	 */
+	class AtomicBitmap : private Noncopyable
+	{
+	public:
+		AtomicBitmap() :
+			m_word_count(0)
+		{
+		}
+
+		void resize(size_t bitCount)
+		{
+			this->m_word_count = (bitCount + 63) / 64;
+			this->m_words.reset(new std::atomic< uint64_t >[this->m_word_count]);
+			for (size_t i = 0; i < this->m_word_count; ++i)
+			{
+				this->m_words[i].store(0, std::memory_order_relaxed);
+			}
+		}
+
+		// sets the bit and returns whether it was already set
+		bool testAndSet(size_t index)
+		{
+			uint64_t mask = (uint64_t)1 << (index % 64);
+			return (this->m_words[index / 64].fetch_or(mask, std::memory_order_relaxed) & mask) != 0;
+		}
+
+		size_t size() { return this->m_word_count * 64; }
+
+	private:
+		std::unique_ptr< std::atomic< uint64_t >[] > m_words;
+		size_t m_word_count;
+	};
+}
+
+#endif //GRAPHITE_ATOMICBITMAP_HPP
@@ -0,0 +1,157 @@
+#include "FilePrefetcher.h"
+
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace graphite
+{
+	const uint64_t FilePrefetcher::CHUNK_SIZE;
+	const uint32_t FilePrefetcher::QUEUE_DEPTH;
+	const size_t FilePrefetcher::MAX_PENDING_RANGES;
+
+	FilePrefetcher::FilePrefetcher(const std::string& path) :
+		m_fd(open(path.c_str(), O_RDONLY)),
+		m_stop(false),
+		m_ahead_offset(0),
+		m_buffer(CHUNK_SIZE * QUEUE_DEPTH)
+	{
+#ifdef GRAPHITE_USE_IO_URING
+		this->m_ring_initialized = (this->m_fd >= 0 && io_uring_queue_init(QUEUE_DEPTH, &this->m_ring, 0) == 0);
+#endif
+		// without a file there is nothing to prefetch, the reader reports the error
+		if (this->m_fd >= 0)
+		{
+			this->m_thread = std::thread(&FilePrefetcher::run, this);
+		}
+	}
+
+	FilePrefetcher::~FilePrefetcher()
+	{
+		{
+			std::unique_lock< std::mutex > lock(this->m_lock);
+			this->m_stop = true;
+		}
+		this->m_condition.notify_all();
+		if (this->m_thread.joinable())
+		{
+			this->m_thread.join();
+		}
+#ifdef GRAPHITE_USE_IO_URING
+		if (this->m_ring_initialized)
+		{
+			io_uring_queue_exit(&this->m_ring);
+		}
+#endif
+		if (this->m_fd >= 0)
+		{
+			close(this->m_fd);
+		}
+	}
+
+	/*
+	 * Queues a range and returns right away. When the reader gets too far ahead of the
+	 * prefetcher the oldest ranges are dropped, they would most likely arrive too late.
+	 */
+	void FilePrefetcher::prefetch(uint64_t offset, uint64_t length)
+	{
+		if (this->m_fd < 0 || length == 0)
+		{
+			return;
+		}
+		{
+			std::unique_lock< std::mutex > lock(this->m_lock);
+			if (this->m_ranges.size() >= MAX_PENDING_RANGES)
+			{
+				this->m_ranges.pop_front();
+			}
+			this->m_ranges.emplace_back(offset, length);
+		}
+		this->m_condition.notify_one();
+	}
+
+	/*
+	 * For sequential readers, keeps [offset, offset + window) queued without queueing any byte twice.
+	 */
+	void FilePrefetcher::prefetchAhead(uint64_t offset, uint64_t window)
+	{
+		uint64_t start = std::max(offset, this->m_ahead_offset);
+		// only top up once half the window has been consumed so the ranges stay large
+		if (start >= offset + window / 2)
+		{
+			return;
+		}
+		this->m_ahead_offset = offset + window;
+		prefetch(start, this->m_ahead_offset - start);
+	}
+
+	void FilePrefetcher::run()
+	{
+		while (true)
+		{
+			std::pair< uint64_t, uint64_t > range;
+			{
+				std::unique_lock< std::mutex > lock(this->m_lock);
+				this->m_condition.wait(lock, [this] { return this->m_stop || !this->m_ranges.empty(); });
+				if (this->m_stop)
+				{
+					return;
+				}
+				range = this->m_ranges.front();
+				this->m_ranges.pop_front();
+			}
+			readRange(range.first, range.second);
+		}
+	}
+
+	void FilePrefetcher::readRange(uint64_t offset, uint64_t length)
+	{
+		posix_fadvise(this->m_fd, offset, length, POSIX_FADV_WILLNEED);
+		uint64_t chunkCount = (length + CHUNK_SIZE - 1) / CHUNK_SIZE;
+#ifdef GRAPHITE_USE_IO_URING
+		if (this->m_ring_initialized)
+		{
+			// keep QUEUE_DEPTH reads in flight, the buffer slots may be overwritten by later reads since the data is discarded
+			uint64_t submitted = 0;
+			uint64_t completed = 0;
+			while (completed < chunkCount)
+			{
+				while (submitted < chunkCount && submitted - completed < QUEUE_DEPTH)
+				{
+					struct io_uring_sqe* sqe = io_uring_get_sqe(&this->m_ring);
+					if (sqe == nullptr)
+					{
+						break;
+					}
+					uint64_t chunkOffset = offset + (submitted * CHUNK_SIZE);
+					io_uring_prep_read(sqe, this->m_fd, &this->m_buffer[(submitted % QUEUE_DEPTH) * CHUNK_SIZE], std::min(CHUNK_SIZE, offset + length - chunkOffset), chunkOffset);
+					++submitted;
+				}
+				io_uring_submit(&this->m_ring);
+				struct io_uring_cqe* cqe;
+				if (io_uring_wait_cqe(&this->m_ring, &cqe) < 0)
+				{
+					return;
+				}
+				io_uring_cqe_seen(&this->m_ring, cqe);
+				++completed;
+			}
+			return;
+		}
+#endif
+		for (uint64_t i = 0; i < chunkCount; ++i)
+		{
+			uint64_t chunkOffset = offset + (i * CHUNK_SIZE);
+			if (pread(this->m_fd, this->m_buffer.data(), std::min(CHUNK_SIZE, offset + length - chunkOffset), chunkOffset) <= 0)
+			{
+				return; // past the end of the file
+			}
+			std::unique_lock< std::mutex > lock(this->m_lock);
+			if (this->m_stop)
+			{
+				return;
+			}
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#ifndef GRAPHITE_FILEPREFETCHER_H
+#define GRAPHITE_FILEPREFETCHER_H
+
+#include "Noncopyable.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <stdint.h>
+
+#ifdef GRAPHITE_USE_IO_URING
+#include <liburing.h>
+#endif
+
+namespace graphite
+{
+	/*
+	 * Pulls byte ranges of a file into the page cache on a background thread so the reader
+	 * that later decodes them doesn't block on the filesystem. The ranges are read with
+	 * io_uring when graphite is built with liburing and with pread otherwise, the data
+	 * itself is thrown away.
+	 */
+	class FilePrefetcher : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< FilePrefetcher > SharedPtr;
+		FilePrefetcher(const std::string& path);
+		~FilePrefetcher();
+
+		void prefetch(uint64_t offset, uint64_t length);
+		void prefetchAhead(uint64_t offset, uint64_t window);
+
+	private:
+		void run();
+		void readRange(uint64_t offset, uint64_t length);
+
+		static const uint64_t CHUNK_SIZE = 128 * 1024;
+		static const uint32_t QUEUE_DEPTH = 16;
+		static const size_t MAX_PENDING_RANGES = 64;
+
+		int m_fd;
+		bool m_stop;
+		uint64_t m_ahead_offset; // everything before this has already been queued by prefetchAhead
+		std::deque< std::pair< uint64_t, uint64_t > > m_ranges;
+		std::vector< char > m_buffer;
+		std::mutex m_lock;
+		std::condition_variable m_condition;
+		std::thread m_thread;
+#ifdef GRAPHITE_USE_IO_URING
+		struct io_uring m_ring;
+		bool m_ring_initialized;
+#endif
+	};
+}
+
+#endif //GRAPHITE_FILEPREFETCHER_H
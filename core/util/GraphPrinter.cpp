@@ -3,6 +3,7 @@
 #include "core/graph/Graph.h"
 
 #include <algorithm>
+#include <mutex>
 
 namespace graphite
 {
@@ -0,0 +1,141 @@
+#include "LineReader.h"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace graphite
+{
+	const size_t LineReader::BLOCK_SIZE;
+	const unsigned int LineReader::ZLIB_BUFFER_SIZE;
+
+	LineReader::LineReader(const std::string& path) :
+		m_gz_file(nullptr),
+		m_mapped_ptr(nullptr),
+		m_mapped_size(0),
+		m_data(nullptr),
+		m_size(0),
+		m_position(0),
+		m_eof(false)
+	{
+		if (path.substr(path.find_last_of(".") + 1) == "gz")
+		{
+			this->m_gz_file = gzopen(path.c_str(), "rb");
+			if (this->m_gz_file != nullptr)
+			{
+				gzbuffer(this->m_gz_file, ZLIB_BUFFER_SIZE); // zlib's default is 8KB of compressed input per read
+			}
+			else
+			{
+				this->m_eof = true;
+			}
+			return;
+		}
+		// the whole file is visible at once so it never has to be refilled
+		this->m_eof = true;
+		int fd = open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+		{
+			return;
+		}
+		struct stat fileStat;
+		if (fstat(fd, &fileStat) == 0 && fileStat.st_size > 0)
+		{
+			void* mappedPtr = mmap(nullptr, fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mappedPtr != MAP_FAILED)
+			{
+				madvise(mappedPtr, fileStat.st_size, MADV_SEQUENTIAL);
+				this->m_mapped_ptr = (char*)mappedPtr;
+				this->m_mapped_size = fileStat.st_size;
+				this->m_data = this->m_mapped_ptr;
+				this->m_size = this->m_mapped_size;
+			}
+		}
+		close(fd); // the mapping stays valid
+	}
+
+	LineReader::~LineReader()
+	{
+		if (this->m_gz_file != nullptr)
+		{
+			gzclose(this->m_gz_file);
+		}
+		if (this->m_mapped_ptr != nullptr)
+		{
+			munmap(this->m_mapped_ptr, this->m_mapped_size);
+		}
+	}
+
+	bool LineReader::isOpen()
+	{
+		return this->m_gz_file != nullptr || this->m_mapped_ptr != nullptr;
+	}
+
+	bool LineReader::getNextLine(StringView& line)
+	{
+		while (true)
+		{
+			const char* lineStart = this->m_data + this->m_position;
+			size_t remaining = this->m_size - this->m_position;
+			const char* lineEnd = (remaining > 0) ? (const char*)memchr(lineStart, '\n', remaining) : nullptr;
+			if (lineEnd != nullptr)
+			{
+				line = StringView(lineStart, lineEnd - lineStart);
+				this->m_position += (lineEnd - lineStart) + 1;
+				return true;
+			}
+			if (this->m_eof)
+			{
+				if (remaining == 0)
+				{
+					return false;
+				}
+				line = StringView(lineStart, remaining); // the last line has no '\n'
+				this->m_position = this->m_size;
+				return true;
+			}
+			fillBuffer();
+		}
+	}
+
+	/*
+	 * Offset into the file on disk that has been read up to, the compressed offset for gzipped files.
+	 */
+	uint64_t LineReader::getRawOffset()
+	{
+		if (this->m_gz_file != nullptr)
+		{
+			return gzoffset(this->m_gz_file);
+		}
+		return this->m_position;
+	}
+
+	/*
+	 * Moves the unfinished line to the front of the buffer and decompresses the next block behind it.
+	 */
+	bool LineReader::fillBuffer()
+	{
+		size_t remaining = this->m_size - this->m_position;
+		if (remaining > 0 && this->m_position > 0)
+		{
+			memmove(this->m_buffer.data(), this->m_buffer.data() + this->m_position, remaining);
+		}
+		if (this->m_buffer.size() < remaining + BLOCK_SIZE)
+		{
+			this->m_buffer.resize(remaining + BLOCK_SIZE); // lines longer than a block grow the buffer
+		}
+		int readSize = gzread(this->m_gz_file, this->m_buffer.data() + remaining, BLOCK_SIZE);
+		if (readSize <= 0)
+		{
+			this->m_eof = true;
+			readSize = 0;
+		}
+		this->m_data = this->m_buffer.data();
+		this->m_size = remaining + readSize;
+		this->m_position = 0;
+		return readSize > 0;
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef GRAPHITE_LINEREADER_H
+#define GRAPHITE_LINEREADER_H
+
+#include "Noncopyable.hpp"
+#include "StringView.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <zlib.h>
+
+namespace graphite
+{
+	/*
+	 * Reads the lines of a plain or gzipped text file. Plain files are mapped into memory and gzipped
+	 * files are decompressed a few megabytes at a time, lines are handed out as views into that memory
+	 * so no line is copied unless the caller copies it.
+	 */
+	class LineReader : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< LineReader > SharedPtr;
+		LineReader(const std::string& path);
+		~LineReader();
+
+		bool isOpen();
+		/*
+		 * Sets line to the next line without its '\n', the view is only valid until the next call.
+		 */
+		bool getNextLine(StringView& line);
+		uint64_t getRawOffset();
+
+	private:
+		bool fillBuffer();
+
+		static const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+		static const unsigned int ZLIB_BUFFER_SIZE = 256 * 1024;
+
+		gzFile m_gz_file; // nullptr for mapped files
+		char* m_mapped_ptr;
+		size_t m_mapped_size;
+		std::vector< char > m_buffer; // decompressed data of gzipped files, starts with the unfinished line of the previous block
+		const char* m_data;
+		size_t m_size;
+		size_t m_position;
+		bool m_eof;
+	};
+}
+
+#endif //GRAPHITE_LINEREADER_H
@@ -24,8 +24,8 @@ namespace graphite
 		this->m_options.add_options()
 			("h,help","Print help message")
 			("d,include_duplicates", "Include Duplicate Reads")
-			("v,vcf", "Path to input VCF file[s], separate multiple files by space", cxxopts::value< std::vector< std::string > >())
-			("b,bam", "Path to input BAM file[s], separate multiple files by space", cxxopts::value< std::vector< std::string > >())
+			("v,vcf", "Path to input VCF file[s], separate multiple files by space, files ending in .bcf are read and written as BCF", cxxopts::value< std::vector< std::string > >())
+			("b,bam", "Path to input BAM or CRAM file[s], separate multiple files by space, CRAMs are decoded with the FASTA", cxxopts::value< std::vector< std::string > >())
 			("r,region", "Region information", cxxopts::value< std::string >())
 			("o,output_directory", "Path to output directory", cxxopts::value< std::string >())
 			("f,fasta", "Path to input FASTA file", cxxopts::value< std::string >())
@@ -34,7 +34,16 @@ namespace graphite
 			("s,mismatch_value", "Smith-Waterman MisMatch Value [optional - default is 4]", cxxopts::value< uint32_t >()->default_value("4"))
 			("g,gap_open_value", "Smith-Waterman Gap Open Value [optional - default is 6]", cxxopts::value< uint32_t >()->default_value("6"))
 			("e,gap_extionsion_value", "Smith-Waterman Gap Extension Value [optional - default is 1]", cxxopts::value< uint32_t >()->default_value("1"))
-			("i,igv_visualization_output", "Output IGV input for visualization [optional - default is false]");
+			("i,igv_visualization_output", "Output IGV input for visualization [optional - default is false]")
+			("t,threads", "Number of worker threads [optional - default is twice the number of cores]", cxxopts::value< uint32_t >()->default_value("0"))
+			("n,shards", "Split the variants into this many region shards and process them concurrently, shard outputs are merged in input order [optional - default is 1]", cxxopts::value< uint32_t >()->default_value("1"))
+			("w,workers", "Hand the shards to this many local worker processes, failed shards are retried [optional - default is 0, everything runs in this process]", cxxopts::value< uint32_t >()->default_value("0"))
+			("prefetch", "Read the BAM and VCF blocks of the next cluster in the background, helps on network filesystems [optional - default is false]")
+			("sweep", "Read each BAM front to back instead of seeking to every cluster, for VCFs with variants along the whole genome [optional - default is false]")
+			("decompression_threads", "Read BAMs with htslib and decompress them on this many threads per file, CRAMs are always read with htslib [optional - default is 0, BAMs are read with BamTools]", cxxopts::value< uint32_t >()->default_value("0"))
+			("max_depth", "Keep at most this many reads per sample in a cluster, chosen deterministically from the read names, the kept fraction is written to the DSF format field [optional - default is 0, every read is kept]", cxxopts::value< uint32_t >()->default_value("0"))
+			("bgzip_threads", "Write the output VCFs bgzipped with a tabix index, compressing on this many threads, BCF outputs are compressed on them too [optional - default is 0, the outputs are plain text]", cxxopts::value< uint32_t >()->default_value("0"))
+			("worker", "Run as a worker process of a coordinator [internal]");
 		this->m_options.parse(argc, argv);
 	}
 
@@ -135,7 +144,49 @@ namespace graphite
 
 	uint32_t Params::getThreadCount()
 	{
-		return m_options["t"].as< uint32_t >();
+		uint32_t threadCount = m_options["t"].as< uint32_t >();
+		return (threadCount > 0) ? threadCount : std::thread::hardware_concurrency() * 2;
+	}
+
+	uint32_t Params::getShardCount()
+	{
+		uint32_t shardCount = m_options["n"].as< uint32_t >();
+		return (shardCount > 0) ? shardCount : 1;
+	}
+
+	uint32_t Params::getWorkerCount()
+	{
+		return m_options["w"].as< uint32_t >();
+	}
+
+	bool Params::getPrefetch()
+	{
+		return m_options.count("prefetch") > 0;
+	}
+
+	bool Params::getSweep()
+	{
+		return m_options.count("sweep") > 0;
+	}
+
+	uint32_t Params::getDecompressionThreadCount()
+	{
+		return m_options["decompression_threads"].as< uint32_t >();
+	}
+
+	uint32_t Params::getMaxDepth()
+	{
+		return m_options["max_depth"].as< uint32_t >();
+	}
+
+	uint32_t Params::getBgzipThreadCount()
+	{
+		return m_options["bgzip_threads"].as< uint32_t >();
+	}
+
+	bool Params::isWorker()
+	{
+		return m_options.count("worker") > 0;
 	}
 
 	int Params::getMatchValue()
@@ -32,6 +32,14 @@ namespace graphite
         bool getIncludeDuplicates();
 		uint32_t getPercent();
 		uint32_t getThreadCount();
+		uint32_t getShardCount();
+		uint32_t getWorkerCount();
+		bool getPrefetch();
+		bool getSweep();
+		uint32_t getDecompressionThreadCount();
+		uint32_t getMaxDepth();
+		uint32_t getBgzipThreadCount();
+		bool isWorker();
 		int getMatchValue();
 		int getMisMatchValue();
 		int getGapOpenValue();
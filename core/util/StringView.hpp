@@ -0,0 +1,41 @@
+#ifndef GRAPHITE_STRINGVIEW_HPP
+#define GRAPHITE_STRINGVIEW_HPP
+
+#include <cstring>
+#include <string>
+
+namespace graphite
+{
+	/*
+	 * A pointer and a length into characters owned by someone else, only valid as long as the owner
+	 * keeps them where they are.
+	 */
+	class StringView
+	{
+	public:
+		StringView() :
+			m_data(nullptr),
+			m_size(0)
+		{
+		}
+
+		StringView(const char* data, size_t size) :
+			m_data(data),
+			m_size(size)
+		{
+		}
+
+		const char* data() const { return this->m_data; }
+		size_t size() const { return this->m_size; }
+		bool empty() const { return this->m_size == 0; }
+		char operator[](size_t index) const { return this->m_data[index]; }
+		std::string toString() const { return std::string(this->m_data, this->m_size); }
+		bool equals(const std::string& other) const { return other.size() == this->m_size && memcmp(other.data(), this->m_data, this->m_size) == 0; }
+
+	private:
+		const char* m_data;
+		size_t m_size;
+	};
+}
+
+#endif //GRAPHITE_STRINGVIEW_HPP
@@ -24,7 +24,16 @@ namespace graphite
 		~ThreadPool();
 
 		void join();
+		size_t size() const { return workers.size(); }
+		// index of the calling worker within its pool, -1 when called from outside a pool
+		static int getThreadIndex() { return threadIndex(); }
 	private:
+		static int& threadIndex()
+		{
+			static thread_local int index = -1;
+			return index;
+		}
+
 		// need to keep track of threads so we can join them
 		std::vector< std::thread > workers;
 		// the task queue
@@ -43,8 +52,9 @@ namespace graphite
 	{
 		for(size_t i = 0;i<threads;++i)
 			workers.emplace_back(
-				[this]
+				[this, i]
 				{
+					threadIndex() = (int)i;
 					for(;;)
 					{
 						std::function<void()> task;
@@ -57,8 +67,9 @@ namespace graphite
 								return;
 							task = std::move(this->tasks.front());
 							this->tasks.pop();
+							// count the task as running before releasing the lock so join never sees an empty queue with nothing running while a task is in flight
+							m_running_processes += 1;
 						}
-						m_running_processes += 1;
 						task();
 						m_running_processes -= 1;
 					}
@@ -83,8 +94,15 @@ namespace graphite
 
 	inline void ThreadPool::join()
 	{
-		while (m_running_processes > 0)
+		while (true)
 		{
+			{
+				std::unique_lock<std::mutex> lock(queue_mutex);
+				if (this->tasks.empty() && m_running_processes == 0)
+				{
+					break;
+				}
+			}
 			std::this_thread::sleep_for(std::chrono::milliseconds(10));
 		}
 		/*
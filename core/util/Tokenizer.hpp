@@ -0,0 +1,90 @@
+#ifndef GRAPHITE_TOKENIZER_HPP
+#define GRAPHITE_TOKENIZER_HPP
+
+#include "StringView.hpp"
+
+#include <cstring>
+#include <vector>
+#include <stdint.h>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace graphite
+{
+	/*
+	 * Splits text on a delimiter into views of the text and parses numbers out of views, nothing is copied
+	 * or allocated. Delimiters are found sixteen bytes at a time with SSE2 where it is available.
+	 */
+	class Tokenizer
+	{
+	public:
+		// returns the first delimiter in [begin, end) or end if there is none
+		static const char* findDelimiter(const char* begin, const char* end, char delimiter)
+		{
+#if defined(__SSE2__)
+			const __m128i delimiters = _mm_set1_epi8(delimiter);
+			while (end - begin >= 16)
+			{
+				int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)begin), delimiters));
+				if (mask != 0)
+				{
+					return begin + __builtin_ctz(mask);
+				}
+				begin += 16;
+			}
+#endif
+			for (; begin < end; ++begin)
+			{
+				if (*begin == delimiter)
+				{
+					return begin;
+				}
+			}
+			return end;
+		}
+
+		// every field between delimiters, text without a delimiter is a single field
+		static void split(StringView text, char delimiter, std::vector< StringView >& fields)
+		{
+			fields.clear();
+			const char* fieldStart = text.data();
+			const char* end = text.data() + text.size();
+			while (true)
+			{
+				const char* fieldEnd = findDelimiter(fieldStart, end, delimiter);
+				fields.emplace_back(fieldStart, fieldEnd - fieldStart);
+				if (fieldEnd == end)
+				{
+					break;
+				}
+				fieldStart = fieldEnd + 1;
+			}
+		}
+
+		// false unless the whole view is decimal digits that fit in value
+		template < typename T >
+		static bool parseUnsigned(StringView text, T& value)
+		{
+			if (text.empty())
+			{
+				return false;
+			}
+			uint64_t parsedValue = 0;
+			for (size_t i = 0; i < text.size(); ++i)
+			{
+				uint32_t digit = (uint32_t)(text[i] - '0');
+				if (digit > 9 || parsedValue > (((uint64_t)(T)~(T)0) - digit) / 10)
+				{
+					return false;
+				}
+				parsedValue = (parsedValue * 10) + digit;
+			}
+			value = (T)parsedValue;
+			return true;
+		}
+	};
+}
+
+#endif //GRAPHITE_TOKENIZER_HPP
@@ -1,4 +1,5 @@
 #include "Utility.h"
+#include "Tokenizer.hpp"
 
 // #include <regex>
 #include <string>
@@ -14,19 +15,22 @@ namespace graphite
 {
 	void split(const std::string& s, char c, std::vector< std::string >& v)
 	{
-		std::string::size_type i = 0;
-		std::string::size_type j = s.find(c);
-
-		while (j != std::string::npos)
+		const char* end = s.data() + s.size();
+		const char* fieldStart = s.data();
+		const char* fieldEnd = Tokenizer::findDelimiter(fieldStart, end, c);
+		if (fieldEnd == end)
 		{
-			v.push_back(s.substr(i, j-i));
-			i = ++j;
-			j = s.find(c, j);
-
-			if (j == std::string::npos)
+			return; // callers rely on a string without the delimiter adding nothing
+		}
+		while (true)
+		{
+			v.emplace_back(fieldStart, fieldEnd - fieldStart);
+			if (fieldEnd == end)
 			{
-				v.push_back(s.substr(i, s.length()));
+				break;
 			}
+			fieldStart = fieldEnd + 1;
+			fieldEnd = Tokenizer::findDelimiter(fieldStart, end, c);
 		}
 	}
 
@@ -64,4 +68,34 @@ namespace graphite
 		return false;
 	}
 
+	/*
+	 * Appends the decimal digits of value without going through a temporary string, two digits at a time.
+	 */
+	void appendUnsignedInteger(std::string& s, uint32_t value)
+	{
+		static const char DIGIT_PAIRS[] =
+			"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+			"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+			"8081828384858687888990919293949596979899";
+		char digits[10];
+		char* digitsStart = digits + sizeof(digits);
+		while (value >= 100)
+		{
+			uint32_t pairIndex = (value % 100) * 2;
+			value /= 100;
+			*--digitsStart = DIGIT_PAIRS[pairIndex + 1];
+			*--digitsStart = DIGIT_PAIRS[pairIndex];
+		}
+		if (value >= 10)
+		{
+			*--digitsStart = DIGIT_PAIRS[(value * 2) + 1];
+			*--digitsStart = DIGIT_PAIRS[value * 2];
+		}
+		else
+		{
+			*--digitsStart = (char)('0' + value);
+		}
+		s.append(digitsStart, (digits + sizeof(digits)) - digitsStart);
+	}
+
 }
@@ -4,11 +4,14 @@
 #include <string>
 #include <vector>
 
+#include <stdint.h>
+
 namespace graphite
 {
 	void split(const std::string& s, char c, std::vector< std::string >& v);
 	bool fileExists(const std::string& name, bool exitOnFailure);
 	bool folderExists(const std::string& path, bool exitOnFailure);
+	void appendUnsignedInteger(std::string& s, uint32_t value);
 }
 
 #endif //GRAPHITE_CORE_UTIL_UTILITY_H
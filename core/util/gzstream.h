@@ -62,6 +62,8 @@ public:
         // ASSERT: both input & output capabilities will not be used together
     }
     int is_open() { return opened; }
+    // offset in the compressed file, includes input zlib has buffered but not yet inflated
+    z_off_t raw_offset() { return gzoffset( file); }
     gzstreambuf* open( const char* name, int open_mode);
     gzstreambuf* close();
     ~gzstreambuf() { close(); }
@@ -0,0 +1,436 @@
+#include "VCFFileWriter.h"
+#include "core/util/Tokenizer.hpp"
+
+#include <cstdlib>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#include <zlib.h>
+
+namespace graphite
+{
+	const size_t VCFFileWriter::BUFFER_SIZE;
+	const size_t VCFFileWriter::MAX_PENDING_BUFFERS;
+	const size_t VCFFileWriter::BGZF_BLOCK_SIZE;
+
+	VCFFileWriter::VCFFileWriter(const std::string& path, uint32_t compressionThreadCount) :
+		m_path(path),
+		m_bcf(isBCFPath(path)),
+		m_compress(!m_bcf && compressionThreadCount > 0),
+		m_closed(false),
+		m_stop(false),
+		m_compressed_offset(0),
+		m_index_ptr(nullptr),
+		m_index_failed(false),
+		m_header_end_offset(0),
+		m_bcf_file_ptr(nullptr),
+		m_bcf_header_ptr(nullptr),
+		m_bcf_record_ptr(nullptr)
+	{
+		this->m_bcf_line.l = 0;
+		this->m_bcf_line.m = 0;
+		this->m_bcf_line.s = nullptr;
+		this->m_buffer.reserve(BUFFER_SIZE + 64 * 1024);
+		if (this->m_bcf)
+		{
+			this->m_bcf_file_ptr = hts_open(path.c_str(), "wb");
+			if (this->m_bcf_file_ptr == nullptr)
+			{
+				std::cout << "graphite: unable to open " << path << " for writing" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			if (compressionThreadCount > 0)
+			{
+				hts_set_threads(this->m_bcf_file_ptr, compressionThreadCount);
+			}
+			this->m_bcf_record_ptr = bcf_init();
+		}
+		else
+		{
+			this->m_out_file.open(path, std::ios::binary | std::ios::trunc);
+		}
+		if (this->m_compress)
+		{
+			this->m_compression_pool_ptr = std::unique_ptr< ThreadPool >(new ThreadPool(compressionThreadCount));
+		}
+		this->m_thread = std::thread(&VCFFileWriter::run, this);
+	}
+
+	VCFFileWriter::~VCFFileWriter()
+	{
+		close();
+	}
+
+	void VCFFileWriter::writeLine(const std::string& line)
+	{
+		writeLine(line.data(), line.size());
+	}
+
+	void VCFFileWriter::writeLine(const char* line, size_t size)
+	{
+		this->m_buffer.append(line, size);
+		this->m_buffer.push_back('\n');
+		// buffers only end between lines so every record lies in one buffer
+		if (this->m_buffer.size() >= BUFFER_SIZE)
+		{
+			handOffBuffer();
+		}
+	}
+
+	/*
+	 * Writes everything that is still buffered, waits for the background thread and finishes the BGZF file and its index.
+	 */
+	void VCFFileWriter::close()
+	{
+		if (this->m_closed)
+		{
+			return;
+		}
+		this->m_closed = true;
+		handOffBuffer();
+		{
+			std::unique_lock< std::mutex > lock(this->m_lock);
+			this->m_stop = true;
+		}
+		this->m_condition.notify_all();
+		this->m_thread.join();
+		if (this->m_bcf)
+		{
+			bcf_destroy(this->m_bcf_record_ptr);
+			if (this->m_bcf_header_ptr != nullptr)
+			{
+				bcf_hdr_destroy(this->m_bcf_header_ptr);
+			}
+			hts_close(this->m_bcf_file_ptr);
+			free(this->m_bcf_line.s);
+			if (this->m_bcf_header_ptr != nullptr && bcf_index_build(this->m_path.c_str(), 14) != 0)
+			{
+				std::cout << "graphite: unable to write the index of " << this->m_path << std::endl;
+			}
+			return;
+		}
+		if (this->m_compress)
+		{
+			static const char BGZF_EOF[] = "\037\213\010\4\0\0\0\0\0\377\6\0\102\103\2\0\033\0\3\0\0\0\0\0\0\0\0\0";
+			this->m_out_file.write(BGZF_EOF, sizeof(BGZF_EOF) - 1);
+		}
+		this->m_out_file.close();
+		if (this->m_out_file.fail())
+		{
+			std::cout << "graphite: unable to write " << this->m_path << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if (this->m_compress)
+		{
+			saveIndex();
+		}
+	}
+
+	void VCFFileWriter::handOffBuffer()
+	{
+		if (this->m_buffer.empty())
+		{
+			return;
+		}
+		std::string buffer;
+		buffer.reserve(BUFFER_SIZE + 64 * 1024);
+		buffer.swap(this->m_buffer);
+		{
+			std::unique_lock< std::mutex > lock(this->m_lock);
+			// only block when the disk falls this far behind
+			this->m_condition.wait(lock, [this]() { return this->m_pending_buffers.size() < MAX_PENDING_BUFFERS; });
+			this->m_pending_buffers.emplace_back(std::move(buffer));
+		}
+		this->m_condition.notify_all();
+	}
+
+	void VCFFileWriter::run()
+	{
+		while (true)
+		{
+			std::string buffer;
+			{
+				std::unique_lock< std::mutex > lock(this->m_lock);
+				this->m_condition.wait(lock, [this]() { return this->m_stop || !this->m_pending_buffers.empty(); });
+				if (this->m_pending_buffers.empty())
+				{
+					return; // stopped and everything is written
+				}
+				buffer.swap(this->m_pending_buffers.front());
+				this->m_pending_buffers.pop_front();
+			}
+			this->m_condition.notify_all();
+			if (this->m_bcf)
+			{
+				writeBCFBuffer(buffer);
+			}
+			else if (this->m_compress)
+			{
+				writeCompressedBuffer(buffer);
+			}
+			else
+			{
+				writeBuffer(buffer);
+			}
+		}
+	}
+
+	void VCFFileWriter::writeBuffer(const std::string& buffer)
+	{
+		this->m_out_file.write(buffer.data(), buffer.size());
+	}
+
+	/*
+	 * Encodes the buffer's lines as BCF. The header lines are collected until the #CHROM line, then the header
+	 * is parsed and written and every later line is a record.
+	 */
+	void VCFFileWriter::writeBCFBuffer(const std::string& buffer)
+	{
+		const char* data = buffer.data();
+		size_t lineStart = 0;
+		while (lineStart < buffer.size())
+		{
+			const char* lineEndPtr = (const char*)memchr(data + lineStart, '\n', buffer.size() - lineStart);
+			size_t lineEnd = (lineEndPtr != nullptr) ? (lineEndPtr - data) : buffer.size();
+			if (this->m_bcf_header_ptr == nullptr)
+			{
+				this->m_bcf_header_text.append(data + lineStart, lineEnd - lineStart);
+				this->m_bcf_header_text.push_back('\n');
+				if (lineEnd - lineStart >= 6 && memcmp(data + lineStart, "#CHROM", 6) == 0)
+				{
+					this->m_bcf_header_ptr = bcf_hdr_init("r");
+					if (bcf_hdr_parse(this->m_bcf_header_ptr, &this->m_bcf_header_text[0]) != 0 || bcf_hdr_write(this->m_bcf_file_ptr, this->m_bcf_header_ptr) != 0)
+					{
+						std::cout << "graphite: unable to write the header of " << this->m_path << std::endl;
+						exit(EXIT_FAILURE);
+					}
+				}
+			}
+			else if (lineEnd > lineStart)
+			{
+				this->m_bcf_line.l = 0;
+				kputsn(data + lineStart, lineEnd - lineStart, &this->m_bcf_line);
+				if (vcf_parse(&this->m_bcf_line, this->m_bcf_header_ptr, this->m_bcf_record_ptr) != 0 || bcf_write(this->m_bcf_file_ptr, this->m_bcf_header_ptr, this->m_bcf_record_ptr) != 0)
+				{
+					std::cout << "graphite: unable to write a record of " << this->m_path << std::endl;
+					exit(EXIT_FAILURE);
+				}
+			}
+			lineStart = lineEnd + 1;
+		}
+	}
+
+	/*
+	 * Compresses the buffer's blocks on the compression threads and writes them in order.
+	 */
+	void VCFFileWriter::writeCompressedBuffer(const std::string& buffer)
+	{
+		std::vector< std::future< std::string > > blockFutures;
+		for (size_t blockStart = 0; blockStart < buffer.size(); blockStart += BGZF_BLOCK_SIZE)
+		{
+			size_t blockSize = std::min(BGZF_BLOCK_SIZE, buffer.size() - blockStart);
+			blockFutures.emplace_back(this->m_compression_pool_ptr->enqueue(&VCFFileWriter::compressBlock, buffer.data() + blockStart, blockSize));
+		}
+		std::vector< uint64_t > blockAddresses;
+		for (auto& blockFuture : blockFutures)
+		{
+			std::string block = blockFuture.get();
+			blockAddresses.emplace_back(this->m_compressed_offset);
+			this->m_out_file.write(block.data(), block.size());
+			this->m_compressed_offset += block.size();
+		}
+		if (!this->m_index_failed)
+		{
+			indexBuffer(buffer, blockAddresses, this->m_compressed_offset);
+		}
+	}
+
+	/*
+	 * Adds the buffer's records to the tabix index. A record's entry points just past it, the virtual offset of a byte is
+	 * the address of its block shifted up 16 bits plus its offset inside the block.
+	 */
+	void VCFFileWriter::indexBuffer(const std::string& buffer, const std::vector< uint64_t >& blockAddresses, uint64_t endAddress)
+	{
+		auto getVirtualOffset = [&blockAddresses, endAddress](size_t bufferOffset)
+		{
+			size_t blockIndex = bufferOffset / BGZF_BLOCK_SIZE;
+			return (blockIndex < blockAddresses.size()) ? (blockAddresses[blockIndex] << 16) | (bufferOffset % BGZF_BLOCK_SIZE) : (endAddress << 16);
+		};
+		const char* data = buffer.data();
+		size_t lineStart = 0;
+		while (lineStart < buffer.size())
+		{
+			const char* lineEndPtr = (const char*)memchr(data + lineStart, '\n', buffer.size() - lineStart);
+			size_t lineEnd = (lineEndPtr != nullptr) ? (lineEndPtr - data) + 1 : buffer.size();
+			const char* line = data + lineStart;
+			size_t lineSize = lineEnd - lineStart;
+			if (line[0] == tbx_conf_vcf.meta_char)
+			{
+				this->m_header_end_offset = getVirtualOffset(lineEnd);
+				lineStart = lineEnd;
+				continue;
+			}
+
+			// tabix's vcf intervals run from POS - 1 to POS - 1 + the length of REF, or to END from the INFO column
+			const char* columns[8];
+			size_t columnSizes[8];
+			size_t columnCount = 0;
+			const char* columnStart = line;
+			const char* lineStop = line + lineSize - ((line[lineSize - 1] == '\n') ? 1 : 0);
+			while (columnCount < 8 && columnStart <= lineStop)
+			{
+				const char* columnStop = Tokenizer::findDelimiter(columnStart, lineStop, '\t');
+				columns[columnCount] = columnStart;
+				columnSizes[columnCount] = columnStop - columnStart;
+				++columnCount;
+				columnStart = columnStop + 1;
+			}
+			if (columnCount < 5)
+			{
+				lineStart = lineEnd;
+				continue; // not a record
+			}
+			std::string referenceName(columns[0], columnSizes[0]);
+			auto idIter = this->m_reference_ids.find(referenceName);
+			if (idIter == this->m_reference_ids.end())
+			{
+				idIter = this->m_reference_ids.emplace(referenceName, this->m_reference_names.size()).first;
+				this->m_reference_names.emplace_back(referenceName);
+			}
+			uint32_t recordPosition = 0;
+			Tokenizer::parseUnsigned(StringView(columns[1], columnSizes[1]), recordPosition);
+			int begin = (int)recordPosition - 1;
+			int end = begin + (int)columnSizes[3];
+			if (columnCount == 8)
+			{
+				std::vector< StringView > infoFields;
+				Tokenizer::split(StringView(columns[7], columnSizes[7]), ';', infoFields);
+				for (auto& infoField : infoFields)
+				{
+					uint32_t infoEnd = 0;
+					if (infoField.size() > 4 && memcmp(infoField.data(), "END=", 4) == 0 && Tokenizer::parseUnsigned(StringView(infoField.data() + 4, infoField.size() - 4), infoEnd))
+					{
+						end = std::max(end, (int)infoEnd);
+					}
+				}
+			}
+			if (this->m_index_ptr == nullptr)
+			{
+				this->m_index_ptr = hts_idx_init(0, HTS_FMT_TBI, (this->m_header_end_offset != 0) ? this->m_header_end_offset : getVirtualOffset(lineStart), 14, 5);
+			}
+			if (hts_idx_push(this->m_index_ptr, idIter->second, begin, end, getVirtualOffset(lineEnd), 1) < 0)
+			{
+				std::cout << "graphite: " << this->m_path << " is not sorted, it is written without an index" << std::endl;
+				hts_idx_destroy(this->m_index_ptr);
+				this->m_index_ptr = nullptr;
+				this->m_index_failed = true;
+				return;
+			}
+			lineStart = lineEnd;
+		}
+	}
+
+	/*
+	 * Finishes the index with the same meta data tabix writes (its vcf configuration and the sequence names) and saves it next to the file.
+	 */
+	void VCFFileWriter::saveIndex()
+	{
+		if (this->m_index_failed)
+		{
+			return;
+		}
+		if (this->m_index_ptr == nullptr)
+		{
+			this->m_index_ptr = hts_idx_init(0, HTS_FMT_TBI, this->m_header_end_offset, 14, 5);
+		}
+		hts_idx_finish(this->m_index_ptr, this->m_compressed_offset << 16);
+		int32_t namesSize = 0;
+		for (auto& referenceName : this->m_reference_names)
+		{
+			namesSize += referenceName.size() + 1;
+		}
+		int32_t config[7] = {tbx_conf_vcf.preset, tbx_conf_vcf.sc, tbx_conf_vcf.bc, tbx_conf_vcf.ec, tbx_conf_vcf.meta_char, tbx_conf_vcf.line_skip, namesSize};
+		uint8_t* meta = (uint8_t*)malloc(sizeof(config) + namesSize); // owned by the index
+		memcpy(meta, config, sizeof(config));
+		size_t metaOffset = sizeof(config);
+		for (auto& referenceName : this->m_reference_names)
+		{
+			memcpy(meta + metaOffset, referenceName.c_str(), referenceName.size() + 1);
+			metaOffset += referenceName.size() + 1;
+		}
+		hts_idx_set_meta(this->m_index_ptr, sizeof(config) + namesSize, meta, 0);
+		if (hts_idx_save(this->m_index_ptr, this->m_path.c_str(), HTS_FMT_TBI) != 0)
+		{
+			std::cout << "graphite: unable to write the index of " << this->m_path << std::endl;
+		}
+		hts_idx_destroy(this->m_index_ptr);
+		this->m_index_ptr = nullptr;
+	}
+
+	bool VCFFileWriter::isBCFPath(const std::string& path)
+	{
+		return path.size() > 4 && path.compare(path.size() - 4, 4, ".bcf") == 0;
+	}
+
+	/*
+	 * One BGZF block: a gzip member with the BC extra field holding the block size, a raw deflate stream, the CRC32 and the input size.
+	 */
+	std::string VCFFileWriter::compressBlock(const char* data, size_t size)
+	{
+		static const size_t HEADER_SIZE = 18;
+		static const size_t FOOTER_SIZE = 8;
+		static const size_t MAX_BLOCK_SIZE = 64 * 1024;
+		std::string block;
+		int level = Z_DEFAULT_COMPRESSION;
+		while (true)
+		{
+			z_stream stream;
+			memset(&stream, 0, sizeof(stream));
+			int status = deflateInit2(&stream, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY);
+			if (status != Z_OK)
+			{
+				std::cout << "graphite: unable to start compressing a BGZF block, zlib error " << status << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			block.resize(HEADER_SIZE + deflateBound(&stream, size) + FOOTER_SIZE);
+			stream.next_in = (Bytef*)data;
+			stream.avail_in = size;
+			stream.next_out = (Bytef*)&block[HEADER_SIZE];
+			stream.avail_out = block.size() - HEADER_SIZE - FOOTER_SIZE;
+			// the output holds deflateBound bytes so the whole block is compressed in one call
+			status = deflate(&stream, Z_FINISH);
+			if (status != Z_STREAM_END)
+			{
+				std::cout << "graphite: unable to compress a BGZF block, zlib error " << status << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			size_t compressedSize = stream.total_out;
+			status = deflateEnd(&stream);
+			if (status != Z_OK)
+			{
+				std::cout << "graphite: unable to finish a BGZF block, zlib error " << status << std::endl;
+				exit(EXIT_FAILURE);
+			}
+			block.resize(HEADER_SIZE + compressedSize + FOOTER_SIZE);
+			if (block.size() <= MAX_BLOCK_SIZE || level == 0)
+			{
+				break;
+			}
+			level = 0; // incompressible data is stored, which always fits
+		}
+		static const unsigned char HEADER[HEADER_SIZE] = {31, 139, 8, 4, 0, 0, 0, 0, 0, 255, 6, 0, 'B', 'C', 2, 0, 0, 0};
+		memcpy(&block[0], HEADER, HEADER_SIZE);
+		size_t blockSizeMinusOne = block.size() - 1;
+		block[16] = (char)(blockSizeMinusOne & 0xff);
+		block[17] = (char)((blockSizeMinusOne >> 8) & 0xff);
+		uint32_t crc = crc32(crc32(0L, Z_NULL, 0), (const Bytef*)data, size);
+		uint32_t inputSize = size;
+		for (int i = 0; i < 4; ++i)
+		{
+			block[block.size() - 8 + i] = (char)((crc >> (8 * i)) & 0xff);
+			block[block.size() - 4 + i] = (char)((inputSize >> (8 * i)) & 0xff);
+		}
+		return block;
+	}
+}
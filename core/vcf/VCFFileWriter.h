@@ -0,0 +1,93 @@
+#ifndef GRAPHITE_VCFFILEWRITER_H
+#define GRAPHITE_VCFFILEWRITER_H
+
+#include "core/util/Noncopyable.hpp"
+#include "core/util/ThreadPool.hpp"
+
+#include <htslib/hts.h>
+#include <htslib/tbx.h>
+#include <htslib/vcf.h>
+#include <htslib/kstring.h>
+
+#include <condition_variable>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <stdint.h>
+
+namespace graphite
+{
+	/*
+	 * Writes the lines of a vcf file from a background thread. Lines are collected in a large buffer
+	 * and every full buffer is handed to the thread so the caller never waits on the disk. With
+	 * compression threads the file is written as BGZF, each buffer's blocks are compressed on those
+	 * threads, and a tabix index of the records is built as the blocks are written. A path ending in .bcf
+	 * is written as BCF, the lines are encoded by htslib on the background thread and a csi index is built on close.
+	 *
+	 * The BGZF blocks, the EOF marker and the tabix meta data are written here rather than with htslib's bgzf_mt and
+	 * hts_idx_push because in htslib 1.9 (the pinned release) bgzf_tell is not exact while blocks are compressed on
+	 * bgzf_mt's threads, so records can't be indexed as they are written. Compressing the blocks here gives every block's
+	 * address before its records are indexed.
+	 */
+	class VCFFileWriter : private Noncopyable
+	{
+	public:
+		typedef std::shared_ptr< VCFFileWriter > SharedPtr;
+		VCFFileWriter(const std::string& path, uint32_t compressionThreadCount);
+		~VCFFileWriter();
+
+		void writeLine(const std::string& line);
+		void writeLine(const char* line, size_t size);
+		void close();
+
+		static bool isBCFPath(const std::string& path);
+
+	private:
+		void run();
+		void writeBuffer(const std::string& buffer);
+		void writeCompressedBuffer(const std::string& buffer);
+		void writeBCFBuffer(const std::string& buffer);
+		void indexBuffer(const std::string& buffer, const std::vector< uint64_t >& blockAddresses, uint64_t endAddress);
+		void saveIndex();
+		void handOffBuffer();
+		static std::string compressBlock(const char* data, size_t size);
+
+		static const size_t BUFFER_SIZE = 4 * 1024 * 1024;
+		static const size_t MAX_PENDING_BUFFERS = 4;
+		static const size_t BGZF_BLOCK_SIZE = 0xff00; // uncompressed bytes per block, what bgzip uses
+
+		std::string m_path;
+		std::ofstream m_out_file;
+		bool m_bcf;
+		bool m_compress;
+		bool m_closed;
+		std::string m_buffer;
+		std::deque< std::string > m_pending_buffers;
+		bool m_stop;
+		std::mutex m_lock;
+		std::condition_variable m_condition;
+		std::thread m_thread;
+		std::unique_ptr< ThreadPool > m_compression_pool_ptr;
+
+		// only touched by the background thread
+		uint64_t m_compressed_offset;
+		hts_idx_t* m_index_ptr;
+		bool m_index_failed;
+		uint64_t m_header_end_offset; // virtual offset after the last header line
+		std::unordered_map< std::string, int > m_reference_ids;
+		std::vector< std::string > m_reference_names; // in id order
+		htsFile* m_bcf_file_ptr;
+		bcf_hdr_t* m_bcf_header_ptr; // set once the #CHROM line is written
+		bcf1_t* m_bcf_record_ptr;
+		std::string m_bcf_header_text;
+		kstring_t m_bcf_line;
+	};
+}
+
+#endif //GRAPHITE_VCFFILEWRITER_H
@@ -1,49 +1,193 @@
 #include "VCFReader.h"
 #include "core/util/Utility.h"
+#include "core/util/Tokenizer.hpp"
 
 #include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <cstring>
+#include <cstdlib>
 
 
 namespace graphite
 {
+	const size_t VCFReader::PARSE_BATCH_SIZE;
+	const size_t VCFReader::MAX_QUEUED_VARIANTS;
+
 	VCFReader::VCFReader(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, Region::SharedPtr regionPtr, VCFWriter::SharedPtr vcfWriter) :
-		m_filename(filename),
-		m_region_ptr(nullptr),
-		m_file_stream_ptr(nullptr),
+		VCFReader(filename, bamSamplePtrs, (regionPtr == nullptr) ? std::vector< Region::SharedPtr >() : std::vector< Region::SharedPtr >({regionPtr}), vcfWriter)
+	{
+	}
+
+	VCFReader::VCFReader(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::vector< Region::SharedPtr >& regionPtrs, VCFWriter::SharedPtr vcfWriter) :
 		m_preloaded_variant(nullptr),
-		m_vcf_writer(vcfWriter)
+		m_vcf_writer(vcfWriter),
+		m_region_ptr(nullptr),
+		m_region_ptrs(regionPtrs),
+		m_region_index(0),
+		m_filename(filename),
+		m_line_reader_ptr(nullptr),
+		m_hts_file_ptr(nullptr),
+		m_tbx_ptr(nullptr),
+		m_index_itr_ptr(nullptr),
+		m_bcf_header_ptr(nullptr),
+		m_bcf_record_ptr(nullptr),
+		m_bcf_index_ptr(nullptr),
+		m_parsing_done(false),
+		m_stop_parsing(false)
 	{
+		this->m_tbx_line.l = 0;
+		this->m_tbx_line.m = 0;
+		this->m_tbx_line.s = nullptr;
 		openFile(); // open the vcf
 		processHeader(bamSamplePtrs); // read the header
-		setRegion(regionPtr);
+		if (this->m_region_ptrs.size() > 0)
+		{
+			openIndex();
+		}
 	}
 
 	VCFReader::~VCFReader()
 	{
-		if (this->m_filename.substr(this->m_filename.find_last_of(".") + 1) == "gz")
+		if (this->m_parse_thread.joinable())
+		{
+			{
+				std::unique_lock< std::mutex > lock(this->m_parse_lock);
+				this->m_stop_parsing = true;
+			}
+			this->m_parse_condition.notify_all();
+			this->m_parse_thread.join();
+		}
+		if (this->m_index_itr_ptr != nullptr)
+		{
+			hts_itr_destroy(this->m_index_itr_ptr);
+		}
+		if (this->m_tbx_ptr != nullptr)
 		{
-			std::static_pointer_cast< igzstream >(m_file_stream_ptr)->close();
+			tbx_destroy(this->m_tbx_ptr);
 		}
-		else
+		if (this->m_bcf_index_ptr != nullptr)
 		{
-			std::static_pointer_cast< std::ifstream >(m_file_stream_ptr)->close();
+			hts_idx_destroy(this->m_bcf_index_ptr);
 		}
+		if (this->m_bcf_record_ptr != nullptr)
+		{
+			bcf_destroy(this->m_bcf_record_ptr);
+		}
+		if (this->m_bcf_header_ptr != nullptr)
+		{
+			bcf_hdr_destroy(this->m_bcf_header_ptr);
+		}
+		if (this->m_hts_file_ptr != nullptr)
+		{
+			hts_close(this->m_hts_file_ptr);
+		}
+		free(this->m_tbx_line.s);
 	}
 
 	void VCFReader::openFile()
 	{
-		if (this->m_filename.substr(this->m_filename.find_last_of(".") + 1) == "gz")
+		if (!VCFFileWriter::isBCFPath(this->m_filename))
+		{
+			this->m_line_reader_ptr = std::make_shared< LineReader >(this->m_filename);
+			return;
+		}
+		this->m_hts_file_ptr = hts_open(this->m_filename.c_str(), "rb");
+		this->m_bcf_header_ptr = (this->m_hts_file_ptr != nullptr) ? bcf_hdr_read(this->m_hts_file_ptr) : nullptr;
+		if (this->m_bcf_header_ptr == nullptr)
+		{
+			std::cout << "Unable to open BCF: " << this->m_filename << std::endl;
+			exit(EXIT_FAILURE);
+		}
+		this->m_bcf_record_ptr = bcf_init();
+		// the header goes through the same rewriting as a vcf's so it is handed out as lines too
+		kstring_t headerText = {0, 0, nullptr};
+		bcf_hdr_format(this->m_bcf_header_ptr, 0, &headerText);
+		std::vector< std::string > headerLines;
+		split(std::string(headerText.s, headerText.l), '\n', headerLines);
+		free(headerText.s);
+		for (auto& headerLine : headerLines)
+		{
+			if (!headerLine.empty())
+			{
+				this->m_bcf_header_lines.emplace_back(headerLine);
+			}
+		}
+	}
+
+	/*
+	 * Decodes the next bcf record, from the current region's iterator when the bcf is indexed, and formats it as a vcf line.
+	 */
+	bool VCFReader::getNextBCFLine(StringView& line)
+	{
+		if (!this->m_bcf_header_lines.empty())
+		{
+			this->m_bcf_header_line.swap(this->m_bcf_header_lines.front());
+			line = StringView(this->m_bcf_header_line.data(), this->m_bcf_header_line.size());
+			this->m_bcf_header_lines.pop_front();
+			return true;
+		}
+		if (this->m_bcf_index_ptr != nullptr)
+		{
+			if (this->m_index_itr_ptr == nullptr || bcf_itr_next(this->m_hts_file_ptr, this->m_index_itr_ptr, this->m_bcf_record_ptr) < 0)
+			{
+				return false;
+			}
+		}
+		else if (bcf_read(this->m_hts_file_ptr, this->m_bcf_header_ptr, this->m_bcf_record_ptr) < 0)
+		{
+			return false;
+		}
+		this->m_tbx_line.l = 0;
+		if (vcf_format(this->m_bcf_header_ptr, this->m_bcf_record_ptr, &this->m_tbx_line) < 0)
+		{
+			return false;
+		}
+		size_t lineSize = this->m_tbx_line.l;
+		if (lineSize > 0 && this->m_tbx_line.s[lineSize - 1] == '\n')
+		{
+			--lineSize;
+		}
+		line = StringView(this->m_tbx_line.s, lineSize);
+		return true;
+	}
+
+	/*
+	 * Reads the regions through the .tbi or .csi next to a bgzipped vcf so every region is seeked to instead of
+	 * reached by reading every line before it, a bcf is seeked through the .csi next to it. Without an index the
+	 * regions are found by reading the whole file.
+	 */
+	void VCFReader::openIndex()
+	{
+		if (this->m_bcf_header_ptr != nullptr)
+		{
+			std::ifstream csiFile(this->m_filename + ".csi");
+			if (csiFile.good())
+			{
+				this->m_bcf_index_ptr = bcf_index_load(this->m_filename.c_str());
+			}
+			return;
+		}
+		if (this->m_filename.substr(this->m_filename.find_last_of(".") + 1) != "gz")
+		{
+			return;
+		}
+		std::ifstream tbiFile(this->m_filename + ".tbi");
+		std::ifstream csiFile(this->m_filename + ".csi");
+		if (!tbiFile.good() && !csiFile.good()) // tbx_index_load complains about missing indices
+		{
+			return;
+		}
+		this->m_tbx_ptr = tbx_index_load(this->m_filename.c_str());
+		if (this->m_tbx_ptr == nullptr)
 		{
-			auto igzstreamPtr = std::make_shared< igzstream >();
-			igzstreamPtr->open(this->m_filename.c_str());
-			this->m_file_stream_ptr = igzstreamPtr;
+			return;
 		}
-		else
+		this->m_hts_file_ptr = hts_open(this->m_filename.c_str(), "r");
+		if (this->m_hts_file_ptr == nullptr)
 		{
-			this->m_file_stream_ptr = std::make_shared< std::ifstream >(this->m_filename, std::fstream::in);
+			tbx_destroy(this->m_tbx_ptr);
+			this->m_tbx_ptr = nullptr;
 		}
 	}
 
@@ -54,7 +198,23 @@ namespace graphite
 			return;
 		}
 		this->m_region_ptr = regionPtr;
-		std::string nextLine;
+		StringView nextLine;
+		if (isIndexed())
+		{
+			// the index returns every record overlapping the region, the ones starting before it are skipped below
+			if (this->m_index_itr_ptr != nullptr)
+			{
+				hts_itr_destroy(this->m_index_itr_ptr);
+				this->m_index_itr_ptr = nullptr;
+			}
+			int tid = (this->m_tbx_ptr != nullptr) ? tbx_name2id(this->m_tbx_ptr, regionPtr->getReferenceID().c_str()) : bcf_hdr_name2id(this->m_bcf_header_ptr, regionPtr->getReferenceID().c_str());
+			if (tid >= 0)
+			{
+				position queryStart = (regionPtr->getStartPosition() > 0) ? regionPtr->getStartPosition() - 1 : 0; // indices are zero based
+				this->m_index_itr_ptr = (this->m_tbx_ptr != nullptr) ? tbx_itr_queryi(this->m_tbx_ptr, tid, queryStart, regionPtr->getEndPosition()) : bcf_itr_queryi(this->m_bcf_index_ptr, tid, queryStart, regionPtr->getEndPosition());
+			}
+			this->m_preloaded_variant = getNextLine(nextLine) ? std::make_shared< Variant >(nextLine, this->m_vcf_writer) : nullptr;
+		}
 		while (this->m_preloaded_variant != nullptr)
 		{
 			// as soon as we are inside the region then break out
@@ -73,31 +233,157 @@ namespace graphite
 		}
 	}
 
-	bool VCFReader::getNextVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t spacing)
+	/*
+	 * Move on to the next region once the current one is exhausted, returns false when there are no regions left.
+	 */
+	bool VCFReader::advanceRegion()
 	{
-		variantPtrs.clear();
-		std::string nextLine;
-		while (this->m_preloaded_variant != nullptr)
+		if (this->m_region_index + 1 >= this->m_region_ptrs.size())
 		{
-			bool inTheZone = !(this->m_region_ptr != nullptr &&
-				!(this->m_region_ptr->getReferenceID() == this->m_preloaded_variant->getChromosome() &&
-				  this->m_region_ptr->getStartPosition() <= this->m_preloaded_variant->getPosition() &&
-				  this->m_preloaded_variant->getPosition() <= this->m_region_ptr->getEndPosition()));
+			return false;
+		}
+		++this->m_region_index;
+		setRegion(this->m_region_ptrs[this->m_region_index]);
+		return true;
+	}
+
+	void VCFReader::enablePrefetch()
+	{
+		this->m_prefetcher_ptr = std::make_shared< FilePrefetcher >(this->m_filename);
+	}
+
+	uint64_t VCFReader::getFileOffset()
+	{
+		if (this->m_hts_file_ptr != nullptr)
+		{
+			return bgzf_tell(hts_get_bgzfp(this->m_hts_file_ptr)) >> 16; // the upper bits of a virtual offset are the compressed offset
+		}
+		return this->m_line_reader_ptr->getRawOffset();
+	}
 
-			bool isNextVariantCloseEnough = (variantPtrs.size() == 0) ? true : ((this->m_preloaded_variant->getChromosome() ==  variantPtrs[variantPtrs.size()-1]->getChromosome()) && (this->m_preloaded_variant->getPosition() -  variantPtrs[variantPtrs.size()-1]->getPosition()) < spacing); // if we are outside the region then break out
+	bool VCFReader::isInRegion(Variant::SharedPtr variantPtr)
+	{
+		return this->m_region_ptr == nullptr ||
+			(this->m_region_ptr->getReferenceID() == variantPtr->getChromosome() &&
+			 this->m_region_ptr->getStartPosition() <= variantPtr->getPosition() &&
+			 variantPtr->getPosition() <= this->m_region_ptr->getEndPosition());
+	}
 
-			if (!inTheZone || !isNextVariantCloseEnough)
+	/*
+	 * Runs on m_parse_thread, it owns the file, the index and the regions. Variants inside the regions are
+	 * queued in batches and the thread waits while the queue is full.
+	 */
+	void VCFReader::parseVariants()
+	{
+		if (this->m_region_ptrs.size() > 0)
+		{
+			setRegion(this->m_region_ptrs[0]);
+		}
+		std::vector< ParsedVariant > batch;
+		batch.reserve(PARSE_BATCH_SIZE);
+		StringView nextLine;
+		bool done = false;
+		while (!done)
+		{
+			if (this->m_prefetcher_ptr != nullptr)
 			{
-				break;
+				// the vcf is read front to back so keep the next few megabytes on their way
+				this->m_prefetcher_ptr->prefetchAhead(getFileOffset(), 8 * 1024 * 1024);
+			}
+			while (batch.size() < PARSE_BATCH_SIZE)
+			{
+				if (this->m_preloaded_variant == nullptr)
+				{
+					// an indexed reader runs out of records at the end of every region
+					if (isIndexed() && advanceRegion())
+					{
+						continue;
+					}
+					done = true;
+					break;
+				}
+				if (!isInRegion(this->m_preloaded_variant))
+				{
+					if (advanceRegion())
+					{
+						continue;
+					}
+					done = true;
+					break;
+				}
+				batch.emplace_back(this->m_preloaded_variant, this->m_region_index);
+				this->m_preloaded_variant = getNextLine(nextLine) ? std::make_shared< Variant >(nextLine, this->m_vcf_writer) : nullptr;
+			}
+			{
+				std::unique_lock< std::mutex > lock(this->m_parse_lock);
+				this->m_parse_condition.wait(lock, [this]() { return this->m_stop_parsing || this->m_queued_variants.size() < MAX_QUEUED_VARIANTS; });
+				if (this->m_stop_parsing)
+				{
+					return;
+				}
+				this->m_queued_variants.insert(this->m_queued_variants.end(), batch.begin(), batch.end());
+				this->m_parsing_done = done;
 			}
+			this->m_parse_condition.notify_all();
+			batch.clear();
+		}
+	}
 
-			variantPtrs.emplace_back(this->m_preloaded_variant);
-			if (!getNextLine(nextLine)) // if we are at the eof then set the variant to nullptr
+	/*
+	 * Looks at (or takes when remove is set) the next parsed variant, waiting for the parse thread if it is behind.
+	 * Returns false once every variant has been taken.
+	 */
+	bool VCFReader::getNextParsedVariant(Variant::SharedPtr& variantPtr, size_t& regionIndex, bool remove)
+	{
+		if (this->m_ready_variants.empty())
+		{
+			if (!this->m_parse_thread.joinable())
 			{
-				this->m_preloaded_variant = nullptr;
-				break;
+				this->m_parse_thread = std::thread(&VCFReader::parseVariants, this); // started here so enablePrefetch can still be called after construction
 			}
-			this->m_preloaded_variant = std::make_shared< Variant >(nextLine, this->m_vcf_writer);
+			{
+				std::unique_lock< std::mutex > lock(this->m_parse_lock);
+				this->m_parse_condition.wait(lock, [this]() { return this->m_parsing_done || !this->m_queued_variants.empty(); });
+				this->m_ready_variants.swap(this->m_queued_variants);
+			}
+			this->m_parse_condition.notify_all();
+			if (this->m_ready_variants.empty())
+			{
+				return false;
+			}
+		}
+		variantPtr = this->m_ready_variants.front().first;
+		regionIndex = this->m_ready_variants.front().second;
+		if (remove)
+		{
+			this->m_ready_variants.pop_front();
+		}
+		return true;
+	}
+
+	/*
+	 * Groups the next parsed variants into a cluster, a cluster ends at a region's end, on another chromosome
+	 * or where the next variant is at least spacing away from the last one.
+	 */
+	bool VCFReader::getNextVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t spacing)
+	{
+		variantPtrs.clear();
+		Variant::SharedPtr variantPtr;
+		size_t regionIndex = 0;
+		size_t clusterRegionIndex = 0;
+		while (getNextParsedVariant(variantPtr, regionIndex, false))
+		{
+			if (variantPtrs.size() > 0)
+			{
+				bool isNextVariantCloseEnough = regionIndex == clusterRegionIndex && (variantPtr->getChromosome() == variantPtrs.back()->getChromosome()) && (variantPtr->getPosition() - variantPtrs.back()->getPosition()) < spacing;
+				if (!isNextVariantCloseEnough)
+				{
+					break;
+				}
+			}
+			clusterRegionIndex = regionIndex;
+			variantPtrs.emplace_back(variantPtr);
+			getNextParsedVariant(variantPtr, regionIndex, true);
 		}
 		return variantPtrs.size() > 0;
 	}
@@ -106,24 +392,26 @@ namespace graphite
 	{
 		// for each line read and write it to the VCFWriter
 		std::vector< std::string > headerLines;
-		std::string line;
+		StringView line;
+		bool hasLine;
 		std::string headerColumns = "";
-		while (getNextLine(line) && line.c_str()[0] == '#')
+		while ((hasLine = getNextLine(line)) && line.size() > 0 && line[0] == '#')
 		{
-			if (line.find("#CHROM") == std::string::npos)
+			std::string headerLine = line.toString();
+			if (headerLine.find("#CHROM") == std::string::npos)
 			{
-				headerLines.emplace_back(line);
+				headerLines.emplace_back(headerLine);
 			}
 			else
 			{
-				headerColumns = line;
+				headerColumns = headerLine;
 			}
 		}
 		std::string columnLine = setSamplePtrs(headerColumns, bamSamplePtrs);
 		headerLines.emplace_back(columnLine);
 		// this->m_vcf_writer->setSamples(columnLine, this->m_sample_ptrs_map);
 		this->m_vcf_writer->writeHeader(headerLines);
-		if (line.size() > 0)
+		if (hasLine && line.size() > 0) // the first record, a vcf without records ends on its header
 		{
 			this->m_preloaded_variant = std::make_shared< Variant >(line, m_vcf_writer);
 		}
@@ -133,10 +421,11 @@ namespace graphite
 	{
 		std::string newLine = "";
 		std::vector< std::string > sampleNames;
-		std::vector< std::string > columns;
-		split(columnLine, '\t', columns);
-		for (auto column : columns)
+		std::vector< StringView > columnViews;
+		Tokenizer::split(StringView(columnLine.data(), columnLine.size()), '\t', columnViews);
+		for (auto& columnView : columnViews)
 		{
+			std::string column = columnView.toString();
 			std::string upperColumn;
 			std::transform(column.begin(), column.end(), std::back_inserter(upperColumn), ::toupper);
 			if (std::find(STANDARD_VCF_COLUMN_NAMES.begin(), STANDARD_VCF_COLUMN_NAMES.end(), upperColumn) == STANDARD_VCF_COLUMN_NAMES.end())
@@ -3,46 +3,117 @@
 
 #include "core/util/Types.h"
 #include "core/util/Noncopyable.hpp"
-#include "core/util/gzstream.h"
+#include "core/util/LineReader.h"
+#include "core/util/FilePrefetcher.h"
 #include "core/region/Region.h"
 #include "core/sample/Sample.h"
 #include "Variant.h"
 #include "VCFWriter.h"
 
+#include <htslib/hts.h>
+#include <htslib/tbx.h>
+#include <htslib/vcf.h>
+#include <htslib/kstring.h>
+#include <htslib/bgzf.h>
+
+#include <condition_variable>
+#include <deque>
 #include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
 
 #include <istream>
 
 
 namespace graphite
 {
+	/*
+	 * Reads the variants of a vcf inside the regions. The lines are parsed into variants on a background
+	 * thread that stays a bounded number of variants ahead, getNextVariants only groups the parsed variants
+	 * into clusters, so every reader of a multi vcf run parses at the same time.
+	 */
 	class VCFReader : private Noncopyable
 	{
 	public:
 		typedef std::shared_ptr< VCFReader > SharedPtr;
 		VCFReader(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, Region::SharedPtr regionPtr, VCFWriter::SharedPtr vcfWriter);
+		VCFReader(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::vector< Region::SharedPtr >& regionPtrs, VCFWriter::SharedPtr vcfWriter);
 		~VCFReader();
 		bool getNextVariants(std::vector< Variant::SharedPtr >& variantPtrs, uint32_t spacing);
+		void enablePrefetch();
 
 	private:
 		void openFile();
+		void openIndex();
 		void processHeader(std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs);
 		Variant::SharedPtr getNextVariant();
 		void setRegion(Region::SharedPtr regionPtr);
+		bool advanceRegion();
+		uint64_t getFileOffset();
+		bool getNextBCFLine(StringView& line);
+		bool isInRegion(Variant::SharedPtr variantPtr);
+		void parseVariants();
+		bool getNextParsedVariant(Variant::SharedPtr& variantPtr, size_t& regionIndex, bool remove);
 
 		std::string setSamplePtrs(const std::string& columnLine, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs);
 
-		inline bool getNextLine(std::string& line)
+		bool isIndexed() { return this->m_tbx_ptr != nullptr || this->m_bcf_index_ptr != nullptr; }
+
+		/*
+		 * Sets line to the next line, the view is only valid until the next call. Variant keeps its own copy
+		 * of the line so the line is copied once, into the variant it is parsed into.
+		 */
+		inline bool getNextLine(StringView& line)
 		{
-			return (bool)std::getline(*this->m_file_stream_ptr, line);
+			if (this->m_bcf_header_ptr != nullptr)
+			{
+				return getNextBCFLine(line);
+			}
+			if (this->m_tbx_ptr != nullptr)
+			{
+				if (this->m_index_itr_ptr == nullptr || tbx_itr_next(this->m_hts_file_ptr, this->m_tbx_ptr, this->m_index_itr_ptr, &this->m_tbx_line) < 0)
+				{
+					return false;
+				}
+				line = StringView(this->m_tbx_line.s, this->m_tbx_line.l);
+				return true;
+			}
+			return this->m_line_reader_ptr->getNextLine(line);
 		}
 
 		Variant::SharedPtr m_preloaded_variant;
 		VCFWriter::SharedPtr m_vcf_writer;
 		Region::SharedPtr m_region_ptr;
+		std::vector< Region::SharedPtr > m_region_ptrs; // regions are visited in order so they must be in the same order as the file
+		size_t m_region_index;
 		std::string m_filename;
-		std::shared_ptr< std::istream > m_file_stream_ptr;
+		LineReader::SharedPtr m_line_reader_ptr;
+		FilePrefetcher::SharedPtr m_prefetcher_ptr;
+		// set when the regions are read through a tabix index, the header is still read from m_line_reader_ptr.
+		// A bcf is always read through m_hts_file_ptr and its records are handed out as vcf lines
+		htsFile* m_hts_file_ptr;
+		tbx_t* m_tbx_ptr;
+		hts_itr_t* m_index_itr_ptr; // the current region's records
+		kstring_t m_tbx_line;
+		bcf_hdr_t* m_bcf_header_ptr;
+		bcf1_t* m_bcf_record_ptr;
+		hts_idx_t* m_bcf_index_ptr;
+		std::deque< std::string > m_bcf_header_lines; // handed out before the first record
+		std::string m_bcf_header_line; // the header line getNextBCFLine last handed out
         std::unordered_map< std::string, Sample::SharedPtr > m_sample_ptrs_map;
+
+		// variants with the index of the region they were read in, filled by m_parse_thread
+		typedef std::pair< Variant::SharedPtr, size_t > ParsedVariant;
+		static const size_t PARSE_BATCH_SIZE = 256;
+		static const size_t MAX_QUEUED_VARIANTS = 8192;
+		std::deque< ParsedVariant > m_queued_variants; // shared with m_parse_thread
+		std::deque< ParsedVariant > m_ready_variants; // only touched by getNextVariants
+		bool m_parsing_done;
+		bool m_stop_parsing;
+		std::mutex m_parse_lock;
+		std::condition_variable m_parse_condition;
+		std::thread m_parse_thread;
 	};
 }
 
@@ -6,27 +6,52 @@
 
 namespace graphite
 {
-	VCFWriter::VCFWriter(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::string& outputDirectory) :
+	VCFWriter::VCFWriter(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::string& outputDirectory, bool finalOutput, uint32_t compressionThreadCount) :
 		m_bam_sample_ptrs(bamSamplePtrs),
-		m_black_format_string(nullptr)
+		m_black_format_string(nullptr),
+		m_downsample_fraction(false),
+		m_format_column_index(0)
 	{
 		for (auto samplePtr : m_bam_sample_ptrs)
 		{
 			m_bam_sample_ptrs_map.emplace(samplePtr->getName(), samplePtr);
 		}
-		std::string base_filename = filename.substr(filename.find_last_of("/\\") + 1);
-		std::string path(outputDirectory + "/" + base_filename);
-		this->m_out_file.open(path);
+		this->m_out_file_ptr = std::make_shared< VCFFileWriter >(getOutputPath(outputDirectory, filename, finalOutput, compressionThreadCount > 0), compressionThreadCount);
 	}
 
 	VCFWriter::~VCFWriter()
 	{
-		this->m_out_file.close();
+		this->m_out_file_ptr->close();
 	}
 
 	void VCFWriter::writeLine(const std::string& line)
 	{
-		this->m_out_file << line.c_str() << std::endl;
+		this->m_out_file_ptr->writeLine(line);
+	}
+
+	/*
+	 * The output keeps the input's file name and so its format. Outputs that are merged later are always
+	 * plain text, so a bcf input's shards are written as .vcf, and a compressed text output always ends in .gz.
+	 */
+	std::string VCFWriter::getOutputPath(const std::string& outputDirectory, const std::string& vcfPath, bool finalOutput, bool compressed)
+	{
+		std::string baseFilename = vcfPath.substr(vcfPath.find_last_of("/\\") + 1);
+		if (VCFFileWriter::isBCFPath(baseFilename))
+		{
+			if (!finalOutput)
+			{
+				baseFilename.replace(baseFilename.size() - 4, 4, ".vcf");
+			}
+		}
+		else if (finalOutput && compressed)
+		{
+			if (baseFilename.size() > 3 && baseFilename.compare(baseFilename.size() - 3, 3, ".gz") == 0)
+			{
+				baseFilename.resize(baseFilename.size() - 3);
+			}
+			baseFilename += ".gz";
+		}
+		return outputDirectory + "/" + baseFilename;
 	}
 
 	void VCFWriter::writeHeader(const std::vector< std::string >& headerLines)
@@ -82,7 +107,7 @@ namespace graphite
 				this->m_sample_names.emplace(this->m_sample_names.end(), headerName);
 			}
 		}
-		first = true;
+		// the vcf's own columns come first so every added sample needs a separator
 		for (auto bamSamplePtr : this->m_bam_sample_ptrs)
 		{
 			auto sampleName = bamSamplePtr->getName();
@@ -92,10 +117,7 @@ namespace graphite
 									 });
 			if (iter == this->m_vcf_column_names.end()) // if sample not in vcf
 			{
-				if (!first)
-				{
-					headerLine += "\t";
-				}
+				headerLine += "\t";
 				headerLine += sampleName;
 				this->m_vcf_column_names.emplace(this->m_vcf_column_names.end(), sampleName);
 				this->m_sample_names.emplace(this->m_sample_names.end(), sampleName);
@@ -104,11 +126,45 @@ namespace graphite
 			{
 				this->m_sample_name_in_vcf.emplace(sampleName, true);
 			}
-			first = false;
 		}
+		this->m_format_column_index = std::find(this->m_vcf_column_names.begin(), this->m_vcf_column_names.end(), "FORMAT") - this->m_vcf_column_names.begin();
+		setOutputColumns();
 		writeLine(headerLine);
 	}
 
+	/*
+	 * Works out once per header what every record writes into each column, so records don't look up
+	 * the column names of every sample.
+	 */
+	void VCFWriter::setOutputColumns()
+	{
+		this->m_output_columns.clear();
+		for (size_t i = 0; i < this->m_vcf_column_names.size(); ++i)
+		{
+			auto& columnName = this->m_vcf_column_names[i];
+			OutputColumn outputColumn = { OutputColumnType::BlankCounts, 0 };
+			if (i == this->m_format_column_index)
+			{
+				outputColumn.m_type = OutputColumnType::Format;
+			}
+			else if (STANDARD_VCF_COLUMN_NAMES_SET.find(columnName) != STANDARD_VCF_COLUMN_NAMES_SET.end())
+			{
+				outputColumn.m_type = OutputColumnType::Standard;
+			}
+			else if (isSampleNameInBam(columnName))
+			{
+				outputColumn.m_type = OutputColumnType::SampleCounts;
+				outputColumn.m_sample_index = getSamplePtr(columnName)->getIndex();
+			}
+			this->m_output_columns.emplace_back(outputColumn);
+		}
+		this->m_graphite_format_fields = "DP_NFP:DP4_NFP:DP_NP:DP4_NP:DP_EP:DP4_EP:DP_SP:DP4_SP:DP_LP:DP4_LP:DP_AP:DP4_AP";
+		if (this->m_downsample_fraction)
+		{
+			this->m_graphite_format_fields += ":DSF";
+		}
+	}
+
 	/*
 	void VCFWriter::setSamples(const std::string& columnHeaderLine, std::unordered_map< std::string, Sample::SharedPtr >& samplePtrsMap)
 	{
@@ -142,7 +198,7 @@ namespace graphite
 		return this->m_bam_sample_ptrs_map.find(sampleName)->second;
 	}
 
-	std::vector< std::string > VCFWriter::getSampleNames()
+	const std::vector< std::string >& VCFWriter::getSampleNames()
 	{
 		return m_sample_names;
 	}
@@ -157,7 +213,7 @@ namespace graphite
 		return (m_bam_sample_ptrs_map.find(sampleName) != m_bam_sample_ptrs_map.end());
 	}
 
-	std::vector< std::string > VCFWriter::getColumnNames()
+	const std::vector< std::string >& VCFWriter::getColumnNames()
 	{
 		return this->m_vcf_column_names;
 	}
@@ -174,4 +230,16 @@ namespace graphite
 	{
 		return this->m_black_format_string;
 	}
+
+	/*
+	 * Adds the DSF format field, must be called before the header is written.
+	 */
+	void VCFWriter::enableDownsampleFraction()
+	{
+		if (!this->m_downsample_fraction)
+		{
+			this->m_format.emplace_back(std::make_tuple("ID=DSF", "##FORMAT=<ID=DSF,Number=1,Type=Float,Description=\"Fraction of the sample's reads in the cluster that were adjudicated after downsampling to the maximum depth, divide the counts by it to rescale them\">"));
+			this->m_downsample_fraction = true;
+		}
+	}
 }
@@ -1,6 +1,7 @@
 #ifndef GRAPHITE_VCFWRITER_H
 #define GRAPHITE_VCFWRITER_H
 
+#include "VCFFileWriter.h"
 #include "core/util/Noncopyable.hpp"
 #include "core/sample/Sample.h"
 
@@ -17,29 +18,53 @@ namespace graphite
 	{
 	public:
 		typedef std::shared_ptr< VCFWriter > SharedPtr;
-		VCFWriter(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::string& outputDirectory);
+
+		// what a record writes into each output column after the column's own text
+		enum class OutputColumnType { Standard, Format, SampleCounts, BlankCounts };
+		struct OutputColumn
+		{
+			OutputColumnType m_type;
+			uint32_t m_sample_index; // only set for SampleCounts
+		};
+
+		VCFWriter(const std::string& filename, std::vector< graphite::Sample::SharedPtr >& bamSamplePtrs, const std::string& outputDirectory, bool finalOutput, uint32_t compressionThreadCount);
 		~VCFWriter();
 
 		void writeLine(const std::string& line);
+		std::string& getLineBuffer() { return m_line_buffer; }
         void writeHeader(const std::vector< std::string >& headerLines);
 		/* void setSamples(const std::string& columnHeaderLine, std::unordered_map< std::string, Sample::SharedPtr >& samplePtrsMap); */
 		Sample::SharedPtr getSamplePtr(const std::string& sampleName);
 		/* std::vector< Sample::SharedPtr > getSamplePtrs(); */
-		std::vector< std::string > getSampleNames();
-		std::vector< std::string > getColumnNames();
+		const std::vector< std::string >& getSampleNames();
+		const std::vector< std::string >& getColumnNames();
+		size_t getFormatColumnIndex() { return m_format_column_index; }
+		const std::vector< OutputColumn >& getOutputColumns() { return m_output_columns; }
+		const std::string& getGraphiteFormatFields() { return m_graphite_format_fields; }
 		bool isSampleNameInOriginalVCF(const std::string& sampleName);
 		bool isSampleNameInBam(const std::string& sampleName);
 		void setBlankFormatString(const std::string& blankFormatString);
 		std::shared_ptr< std::string > getBlankFormatStringPtr();
+		void enableDownsampleFraction();
+		bool isDownsampleFractionEnabled() { return m_downsample_fraction; }
+
+		static std::string getOutputPath(const std::string& outputDirectory, const std::string& vcfPath, bool finalOutput, bool compressed);
 
 	private:
+		void setOutputColumns();
+
 		std::vector< Sample::SharedPtr > m_bam_sample_ptrs;
 		std::unordered_map< std::string, bool > m_sample_name_in_vcf;
 		std::vector< std::string > m_vcf_column_names;
 		std::vector< std::string > m_sample_names;
-		std::ofstream m_out_file;
+		VCFFileWriter::SharedPtr m_out_file_ptr;
+		std::string m_line_buffer; // reused by every record so the line keeps its capacity
 		std::shared_ptr< std::string > m_black_format_string;
 		std::unordered_map< std::string, Sample::SharedPtr > m_bam_sample_ptrs_map;
+		bool m_downsample_fraction;
+		size_t m_format_column_index; // m_vcf_column_names.size() when there is no FORMAT column
+		std::vector< OutputColumn > m_output_columns; // one per column of m_vcf_column_names, set when the header is written
+		std::string m_graphite_format_fields;
         std::vector< std::tuple< std::string, std::string > > m_format = {std::make_tuple("ID=DP_NFP", "##FORMAT=<ID=DP_NFP,Number=1,Type=Integer,Description=\"Read count at 95 percent Smith Waterman score or above\">"),
 																		  std::make_tuple("ID=DP_NP", "##FORMAT=<ID=DP_NP,Number=1,Type=Integer,Description=\"Read count between 90 and 94 percent Smith Waterman score\">"),
 																		  std::make_tuple("ID=DP_EP", "##FORMAT=<ID=DP_EP,Number=1,Type=Integer,Description=\"Read count between 80 and 89 percent Smith Waterman score\">"),
@@ -50,7 +75,9 @@ namespace graphite
 																		  std::make_tuple("ID=DP4_NP", "##FORMAT=<ID=DP4_NP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling between 90 and 94 percent Smith Waterman score.\">"),
 																		  std::make_tuple("ID=DP4_EP", "##FORMAT=<ID=DP4_EP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling between 80 and 89 percent Smith Waterman score.\">"),
 																		  std::make_tuple("ID=DP4_SP", "##FORMAT=<ID=DP4_SP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling between 70 and 79 percent Smith Waterman score.\">"),
-																		  std::make_tuple("ID=DP4_UP", "##FORMAT=<ID=DP4_UP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling at 69 percent or less Smith Waterman score.\">")};
+																		  std::make_tuple("ID=DP4_UP", "##FORMAT=<ID=DP4_UP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling at 69 percent or less Smith Waterman score.\">"),
+																		  std::make_tuple("ID=DP4_LP", "##FORMAT=<ID=DP4_LP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles, used in variant calling at 69 percent or less Smith Waterman score.\">"),
+																		  std::make_tuple("ID=DP4_AP", "##FORMAT=<ID=DP4_AP,Number=.,Type=Integer,Description=\"Number of 1) forward ref alleles, 2) reverse ref, 3) forward non-ref, 4) reverse non-ref alleles for mappings which map equally well into (or out of) reference and variant.\">")};
 	};
 }
 
@@ -1,15 +1,21 @@
 #include "Variant.h"
 #include "core/util/Utility.h"
 #include "core/util/Types.h"
+#include "core/util/Tokenizer.hpp"
 
 #include <algorithm>
+#include <cstring>
 #include <iostream>
 
 namespace graphite
 {
+	const size_t Variant::CHROM_COLUMN_INDEX;
+	const size_t Variant::POS_COLUMN_INDEX;
+	const size_t Variant::REF_COLUMN_INDEX;
+	const size_t Variant::ALT_COLUMN_INDEX;
 
-	Variant::Variant(const std::string& variantLine, VCFWriter::SharedPtr vcfWriterPtr) :
-		m_variant_line(variantLine),
+	Variant::Variant(StringView variantLine, VCFWriter::SharedPtr vcfWriterPtr) :
+		m_variant_line(variantLine.data(), variantLine.size()),
 		m_vcf_writer_ptr(vcfWriterPtr),
 		m_skip_adjudication(false)
 	{
@@ -21,128 +27,168 @@ namespace graphite
 	{
 	}
 
+	/*
+	 * Writes the original line with the graphite fields spliced onto the end of the FORMAT column and of every
+	 * sample column, columns the line doesn't have (bam samples missing from the vcf) are written blank.
+	 */
 	void Variant::writeVariant()
 	{
-		std::string vcfLine = "";
-		auto columnNames = m_vcf_writer_ptr->getColumnNames();
-		processSampleColumns();
-		for (auto i = 0; i < columnNames.size(); ++i)
+		this->m_reference_allele_ptr->mergeScoreCountShards();
+		for (auto allelePtr : this->m_alternate_allele_ptrs)
 		{
-			if (i > 0)
-			{
-				vcfLine += "\t";
-			}
-			auto columnName = columnNames[i];
-			vcfLine += m_columns[columnName];
-		}
-		this->m_vcf_writer_ptr->writeLine(vcfLine);
-	}
-
-	void Variant::processSampleColumns()
-	{
-		std::string formatSpacing = "";
-		if (m_columns["FORMAT"].size() > 0)
-		{
-			formatSpacing = ":";
+			allelePtr->mergeScoreCountShards();
 		}
-		m_columns["FORMAT"] += formatSpacing + "DP_NFP:DP4_NFP:DP_NP:DP4_NP:DP_EP:DP4_EP:DP_SP:DP4_SP:DP_LP:DP4_LP:DP_AP:DP4_AP";
+		auto& outputColumns = this->m_vcf_writer_ptr->getOutputColumns();
+		auto blankFormatStringPtr = this->m_vcf_writer_ptr->getBlankFormatStringPtr();
+		bool writeDownsampleFraction = this->m_vcf_writer_ptr->isDownsampleFractionEnabled();
+		size_t lineColumnCount = this->m_column_starts.size() - 1;
+		// an empty FORMAT column gets the graphite fields without a separator and so does every sample
+		bool hasFormat = this->m_format_column_index < lineColumnCount && getColumnSize(this->m_format_column_index) > 0;
+		const char* formatSpacing = (hasFormat) ? ":" : "";
 
-		for (auto& sampleName : this->m_vcf_writer_ptr->getSampleNames())
+		std::string& vcfLine = this->m_vcf_writer_ptr->getLineBuffer();
+		vcfLine.clear();
+		vcfLine.reserve(this->m_variant_line.size() + (outputColumns.size() * 64));
+		for (size_t i = 0; i < outputColumns.size(); ++i)
 		{
-			if (this->m_vcf_writer_ptr->isSampleNameInBam(sampleName))
+			if (i > 0)
 			{
-				m_columns[sampleName] += formatSpacing + getSampleCounts(sampleName);
+				vcfLine += '\t';
 			}
-			else
+			if (i < lineColumnCount)
 			{
-				m_columns[sampleName] += formatSpacing + m_blank_graphite_format;
+				vcfLine.append(this->m_variant_line, this->m_column_starts[i], getColumnSize(i));
 			}
-		}
-	}
-
-	void Variant::parseColumns()
-	{
-		m_columns.clear();
-		std::vector< std::string > columns;
-		split(this->m_variant_line, '\t', columns);
-		auto columnNames = this->m_vcf_writer_ptr->getColumnNames();
-		int columnDiff = columns.size() - columnNames.size();
-		for (auto i = 0; i < columnNames.size(); ++i)
-		{
-			if (columnNames[i].compare("FORMAT") == 0 && this->m_vcf_writer_ptr->getBlankFormatStringPtr() == nullptr)
+			else if (blankFormatStringPtr != nullptr)
 			{
-				auto formatCol = columns[i];
-				size_t n = std::count(formatCol.begin(), formatCol.end(), ':');
-				std::string blankSampleFormat = (formatCol.size() > 0) ? "." : "";
-				for (int i = 0; i < n; ++i) { blankSampleFormat += ":."; }
-				this->m_vcf_writer_ptr->setBlankFormatString(blankSampleFormat);
+				vcfLine += *blankFormatStringPtr;
 			}
-			if (i > columns.size() - 1)
+
+			switch (outputColumns[i].m_type)
 			{
-				m_columns.emplace(columnNames[i], *this->m_vcf_writer_ptr->getBlankFormatStringPtr());
-			}
-			else
+			case VCFWriter::OutputColumnType::Standard:
+				break;
+			case VCFWriter::OutputColumnType::Format:
+				vcfLine += formatSpacing;
+				vcfLine += this->m_vcf_writer_ptr->getGraphiteFormatFields();
+				break;
+			case VCFWriter::OutputColumnType::SampleCounts:
 			{
-				m_columns.emplace(columnNames[i], columns[i]);
+				uint32_t sampleIndex = outputColumns[i].m_sample_index;
+				vcfLine += formatSpacing;
+				appendSampleCounts(vcfLine, sampleIndex);
+				if (writeDownsampleFraction)
+				{
+					float downsampleFraction = (sampleIndex < this->m_downsample_fractions.size()) ? this->m_downsample_fractions[sampleIndex] : 1.0f;
+					vcfLine += ':';
+					vcfLine += std::to_string(downsampleFraction);
+				}
+				break;
+			}
+			case VCFWriter::OutputColumnType::BlankCounts:
+				vcfLine += formatSpacing;
+				vcfLine += m_blank_graphite_format;
+				if (writeDownsampleFraction)
+				{
+					vcfLine += ":.";
+				}
+				break;
 			}
 		}
-
-		this->m_chrom = m_columns["#CHROM"];
-		this->m_position = stoi(m_columns["POS"]);
+		this->m_vcf_writer_ptr->writeLine(vcfLine);
 	}
 
-	void Variant::setAlleles()
+	/*
+	 * Records where every column of the line starts instead of copying them, only CHROM, POS, REF and ALT are read here.
+	 */
+	void Variant::parseColumns()
 	{
-		this->m_reference_allele_ptr = std::make_shared< Allele >(m_columns["REF"]);
-		std::vector< std::string > alts;
-		if (m_columns["ALT"].find(",") != std::string::npos)
+		this->m_column_starts.clear();
+		this->m_column_starts.emplace_back(0);
+		const char* lineStart = this->m_variant_line.c_str();
+		const char* lineEnd = lineStart + this->m_variant_line.size();
+		for (const char* tab = Tokenizer::findDelimiter(lineStart, lineEnd, '\t'); tab != lineEnd; tab = Tokenizer::findDelimiter(tab + 1, lineEnd, '\t'))
+		{
+			this->m_column_starts.emplace_back((tab - lineStart) + 1);
+		}
+		this->m_column_starts.emplace_back(this->m_variant_line.size() + 1); // so column i always ends one before column i + 1 starts
+
+		this->m_format_column_index = this->m_vcf_writer_ptr->getFormatColumnIndex();
+		size_t lineColumnCount = this->m_column_starts.size() - 1;
+		if (this->m_format_column_index < lineColumnCount && this->m_vcf_writer_ptr->getBlankFormatStringPtr() == nullptr)
 		{
-			split(m_columns["ALT"], ',', alts);
+			const char* formatStart = lineStart + this->m_column_starts[this->m_format_column_index];
+			size_t formatSize = getColumnSize(this->m_format_column_index);
+			size_t n = std::count(formatStart, formatStart + formatSize, ':');
+			std::string blankSampleFormat = (formatSize > 0) ? "." : "";
+			for (int i = 0; i < n; ++i) { blankSampleFormat += ":."; }
+			this->m_vcf_writer_ptr->setBlankFormatString(blankSampleFormat);
 		}
-		else
+
+		this->m_chrom = getColumn(CHROM_COLUMN_INDEX).toString();
+		if (!Tokenizer::parseUnsigned(getColumn(POS_COLUMN_INDEX), this->m_position))
 		{
-			alts.emplace_back(m_columns["ALT"]);
+			std::cout << "Invalid VCF position: " << getColumn(POS_COLUMN_INDEX).toString() << std::endl;
+			exit(EXIT_FAILURE);
 		}
+	}
+
+	void Variant::setAlleles()
+	{
+		this->m_reference_allele_ptr = std::make_shared< Allele >(getColumn(REF_COLUMN_INDEX).toString());
+		std::vector< StringView > alts;
+		Tokenizer::split(getColumn(ALT_COLUMN_INDEX), ',', alts);
 		this->m_alternate_allele_ptrs.clear();
-		for (auto alt : alts)
+		for (auto& alt : alts)
 		{
-			auto altAllelePtr = std::make_shared< Allele >(alt);
+			auto altAllelePtr = std::make_shared< Allele >(alt.toString());
 			this->m_alternate_allele_ptrs.emplace_back(altAllelePtr);
 		}
 	}
 
-	std::string Variant::getSampleCounts(const std::string& sampleName)
+	StringView Variant::getColumn(size_t columnIndex)
 	{
-		std::string graphiteCountsString = "";
-		AlleleCountType alleleCountType = AlleleCountType::NinteyFivePercent;
-		while (alleleCountType != AlleleCountType::EndEnum)
-		// for (auto alleleCountType : AllAlleleCountTypes)
+		if (columnIndex + 1 >= this->m_column_starts.size())
+		{
+			return StringView();
+		}
+		return StringView(this->m_variant_line.data() + this->m_column_starts[columnIndex], getColumnSize(columnIndex));
+	}
+
+	/*
+	 * Appends the sample's DP and DP4 fields for every count type, the counts are read straight from the
+	 * alleles' merged totals and formatted in place.
+	 */
+	void Variant::appendSampleCounts(std::string& line, uint32_t sampleIndex)
+	{
+		for (uint32_t alleleCountType = 0; alleleCountType < (uint32_t)AlleleCountType::EndEnum; ++alleleCountType)
 		{
 			uint32_t totalCounter = 0;
-			std::unordered_set< std::string > forwardScoreCount;
-			std::unordered_set< std::string > reverseScoreCount;
-			std::unordered_set< std::string > forwardScoreCountTmp = this->m_reference_allele_ptr->getScoreCountFromAlleleCountType(sampleName, alleleCountType, true);
-			std::unordered_set< std::string > reverseScoreCountTmp = this->m_reference_allele_ptr->getScoreCountFromAlleleCountType(sampleName, alleleCountType, false);
-			forwardScoreCount.insert(forwardScoreCountTmp.begin(), forwardScoreCountTmp.end());
-			reverseScoreCount.insert(reverseScoreCountTmp.begin(), reverseScoreCountTmp.end());
-			totalCounter += forwardScoreCount.size() + reverseScoreCount.size();
-			std::string tmpCountsString = std::to_string(forwardScoreCount.size()) + "," + std::to_string(reverseScoreCount.size());
-			for (auto allelePtr : this->m_alternate_allele_ptrs)
+			uint32_t referenceForwardCount = this->m_reference_allele_ptr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, true);
+			uint32_t referenceReverseCount = this->m_reference_allele_ptr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, false);
+			totalCounter += referenceForwardCount + referenceReverseCount;
+			for (auto& allelePtr : this->m_alternate_allele_ptrs)
+			{
+				totalCounter += allelePtr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, true);
+				totalCounter += allelePtr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, false);
+			}
+			if (alleleCountType > 0)
 			{
-				tmpCountsString += ",";
-				forwardScoreCount = allelePtr->getScoreCountFromAlleleCountType(sampleName, alleleCountType, true);
-				reverseScoreCount = allelePtr->getScoreCountFromAlleleCountType(sampleName, alleleCountType, false);
-				tmpCountsString += std::to_string(forwardScoreCount.size()) + "," + std::to_string(reverseScoreCount.size());
-				totalCounter += forwardScoreCount.size() + reverseScoreCount.size();
+				line += ':';
 			}
-			if (!graphiteCountsString.empty())
+			// DP, the total over every allele and strand, comes before the DP4 strand counts
+			appendUnsignedInteger(line, totalCounter);
+			line += ':';
+			appendUnsignedInteger(line, referenceForwardCount);
+			line += ',';
+			appendUnsignedInteger(line, referenceReverseCount);
+			for (auto& allelePtr : this->m_alternate_allele_ptrs)
 			{
-				graphiteCountsString += ":";
+				line += ',';
+				appendUnsignedInteger(line, allelePtr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, true));
+				line += ',';
+				appendUnsignedInteger(line, allelePtr->getScoreCountFromAlleleCountType(sampleIndex, (AlleleCountType)alleleCountType, false));
 			}
-			graphiteCountsString += std::to_string(totalCounter) + ":" + tmpCountsString;
-			alleleCountType = (AlleleCountType)((uint32_t)alleleCountType + 1);
 		}
-
-		return graphiteCountsString;
 	}
 }
@@ -4,6 +4,7 @@
 #include "VCFWriter.h"
 #include "core/util/Noncopyable.hpp"
 #include "core/util/Types.h"
+#include "core/util/StringView.hpp"
 #include "core/sample/Sample.h"
 #include "core/allele/Allele.h"
 // #include "core/graph/Node.h"
@@ -16,33 +17,45 @@ namespace graphite
 	class Variant : private Noncopyable
 	{
 	public:
+		// the fixed columns every vcf starts with
+		static const size_t CHROM_COLUMN_INDEX = 0;
+		static const size_t POS_COLUMN_INDEX = 1;
+		static const size_t REF_COLUMN_INDEX = 3;
+		static const size_t ALT_COLUMN_INDEX = 4;
+
 		typedef std::shared_ptr< Variant > SharedPtr;
-		Variant(const std::string& variantLine, VCFWriter::SharedPtr vcfWriterPtr);
+		Variant(StringView variantLine, VCFWriter::SharedPtr vcfWriterPtr); // keeps its own copy of the line
 		~Variant();
 
 		std::string getChromosome() { return m_chrom; }
 		position getPosition() { return m_position; }
 		Allele::SharedPtr getReferenceAllelePtr() { return this->m_reference_allele_ptr; }
 		std::vector< Allele::SharedPtr > getAlternateAllelePtrs() { return this->m_alternate_allele_ptrs; }
+		void setReferenceAllelePtr(Allele::SharedPtr allelePtr) { this->m_reference_allele_ptr = allelePtr; }
+		void setAlternateAllelePtr(size_t alleleIndex, Allele::SharedPtr allelePtr) { this->m_alternate_allele_ptrs[alleleIndex] = allelePtr; }
 
 		void writeVariant();
+		void setDownsampleFractions(const std::vector< float >& downsampleFractions) { this->m_downsample_fractions = downsampleFractions; }
 
 	private:
-		void processSampleColumns();
 		void parseColumns();
 		void setAlleles();
-		std::string getSampleCounts(const std::string& sampleName);
+		StringView getColumn(size_t columnIndex);
+		size_t getColumnSize(size_t columnIndex) { return this->m_column_starts[columnIndex + 1] - this->m_column_starts[columnIndex] - 1; }
+		void appendSampleCounts(std::string& line, uint32_t sampleIndex);
 		/* std::vector< Node::SharedPtr > getReferenceNodePtrs(); */
 
 		VCFWriter::SharedPtr m_vcf_writer_ptr;
-		std::unordered_map< std::string, std::string > m_columns;
 		std::string m_variant_line;
+		std::vector< uint32_t > m_column_starts; // offset of every column in m_variant_line followed by the line's size + 1
+		size_t m_format_column_index;
 		std::string m_chrom;
 		position m_position;
 		std::string m_blank_graphite_format = ".:.:.:.:.:.:.:.:.:.:.:.";
 		Allele::SharedPtr m_reference_allele_ptr; // make sure to figure out  a way to keep track of breaking up the alleles
 		std::vector< Allele::SharedPtr > m_alternate_allele_ptrs;
 		bool m_skip_adjudication;
+		std::vector< float > m_downsample_fractions; // kept fraction of each sample's reads by sample index
 
 	};
 }
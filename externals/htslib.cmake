@@ -0,0 +1,51 @@
+#  For more information, please see: http://software.sci.utah.edu
+# 
+#  The MIT License
+# 
+#  Copyright (c) 2015 Scientific Computing and Imaging Institute,
+#  University of Utah.
+# 
+#  
+#  Permission is hereby granted, free of charge, to any person obtaining a
+#  copy of this software and associated documentation files (the "Software"),
+#  to deal in the Software without restriction, including without limitation
+#  the rights to use, copy, modify, merge, publish, distribute, sublicense,
+#  and/or sell copies of the Software, and to permit persons to whom the
+#  Software is furnished to do so, subject to the following conditions:
+# 
+#  The above copyright notice and this permission notice shall be included
+#  in all copies or substantial portions of the Software. 
+# 
+#  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+#  OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+#  FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+#  THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+#  LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+#  FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+#  DEALINGS IN THE SOFTWARE.
+
+SET_PROPERTY(DIRECTORY PROPERTY "EP_BASE" ${ep_base})
+
+# Setting up external library for HTSLIB, it is built against our zlib and without the optional compression and network libraries
+SET(HTSLIB_PROJECT htslib_project CACHE INTERNAL "htslib project name")
+SET(HTSLIB_DIR ${CMAKE_BINARY_DIR}/externals/htslib CACHE INTERNAL "htslib project directory")
+SET(HTSLIB_CPPFLAGS "")
+FOREACH(ZLIB_INCLUDE_DIR ${ZLIB_INCLUDE})
+	SET(HTSLIB_CPPFLAGS "${HTSLIB_CPPFLAGS} -I${ZLIB_INCLUDE_DIR}")
+ENDFOREACH()
+ExternalProject_Add(${HTSLIB_PROJECT}
+	GIT_REPOSITORY https://github.com/samtools/htslib.git
+	GIT_TAG 1.9 #lock in the release so this doesn't break in the future
+	DEPENDS ${ZLIB_PROJECT}
+	BUILD_IN_SOURCE 1
+	CONFIGURE_COMMAND autoheader COMMAND autoconf COMMAND ./configure --disable-bz2 --disable-lzma --disable-libcurl --disable-gcs --disable-s3 --disable-plugins "CPPFLAGS=${HTSLIB_CPPFLAGS}" "LDFLAGS=-L${ZLIB_LIBRARY_PATH}"
+	BUILD_COMMAND make lib-static
+	INSTALL_COMMAND ""
+	UPDATE_COMMAND ""
+	PREFIX ${HTSLIB_DIR}
+)
+
+ExternalProject_Get_Property(${HTSLIB_PROJECT} SOURCE_DIR)
+
+SET(HTSLIB_LIB ${SOURCE_DIR}/libhts.a CACHE INTERNAL "HTSLIB Library")
+SET(HTSLIB_INCLUDE ${SOURCE_DIR} CACHE INTERNAL "HTSLIB Include")
@@ -0,0 +1,80 @@
+#ifndef GRAPHITE_TESTS_ATOMICBITMAP_HPP
+#define GRAPHITE_TESTS_ATOMICBITMAP_HPP
+
+#include "core/util/AtomicBitmap.hpp"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST(AtomicBitmapTest, ResizeRoundsUpToWholeWords)
+{
+	graphite::AtomicBitmap atomicBitmap;
+	EXPECT_EQ(0, atomicBitmap.size());
+	atomicBitmap.resize(1);
+	EXPECT_EQ(64, atomicBitmap.size());
+	atomicBitmap.resize(65);
+	EXPECT_EQ(128, atomicBitmap.size());
+}
+
+TEST(AtomicBitmapTest, TestAndSetReportsEarlierSets)
+{
+	graphite::AtomicBitmap atomicBitmap;
+	atomicBitmap.resize(200);
+	EXPECT_FALSE(atomicBitmap.testAndSet(0));
+	EXPECT_TRUE(atomicBitmap.testAndSet(0));
+	EXPECT_FALSE(atomicBitmap.testAndSet(63));
+	EXPECT_FALSE(atomicBitmap.testAndSet(64)); // the first bit of the next word
+	EXPECT_FALSE(atomicBitmap.testAndSet(199));
+	EXPECT_TRUE(atomicBitmap.testAndSet(63));
+	EXPECT_TRUE(atomicBitmap.testAndSet(64));
+	EXPECT_FALSE(atomicBitmap.testAndSet(1));
+}
+
+TEST(AtomicBitmapTest, ResizeClearsEveryBit)
+{
+	graphite::AtomicBitmap atomicBitmap;
+	atomicBitmap.resize(128);
+	for (size_t i = 0; i < 128; ++i)
+	{
+		atomicBitmap.testAndSet(i);
+	}
+	atomicBitmap.resize(128);
+	for (size_t i = 0; i < 128; ++i)
+	{
+		EXPECT_FALSE(atomicBitmap.testAndSet(i)) << i;
+	}
+}
+
+// the graphs use the bitmap so a read shared by several workers is only counted by the first one to claim it
+TEST(AtomicBitmapTest, EveryBitIsClaimedOnceAcrossThreads)
+{
+	const size_t bitCount = 100000;
+	const uint32_t threadCount = 8;
+	graphite::AtomicBitmap atomicBitmap;
+	atomicBitmap.resize(bitCount);
+	std::atomic< size_t > claimCount(0);
+	std::vector< std::thread > threads;
+	for (uint32_t i = 0; i < threadCount; ++i)
+	{
+		threads.emplace_back([&atomicBitmap, &claimCount, bitCount]()
+		{
+			size_t threadClaimCount = 0;
+			for (size_t bitIndex = 0; bitIndex < bitCount; ++bitIndex)
+			{
+				if (!atomicBitmap.testAndSet(bitIndex))
+				{
+					++threadClaimCount;
+				}
+			}
+			claimCount += threadClaimCount;
+		});
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(bitCount, claimCount.load());
+}
+
+#endif //GRAPHITE_TESTS_ATOMICBITMAP_HPP
@@ -0,0 +1,445 @@
+#ifndef GRAPHITE_TESTS_GRAPHITERUNFIXTURE_HPP
+#define GRAPHITE_TESTS_GRAPHITERUNFIXTURE_HPP
+
+#include "TestConfig.h"
+#include "core/util/LineReader.h"
+#include "core/util/Tokenizer.hpp"
+#include "core/vcf/VCFFileWriter.h"
+
+#include "api/BamReader.h"
+#include "api/BamWriter.h"
+
+#include <htslib/bgzf.h>
+#include <htslib/sam.h>
+#include <htslib/tbx.h>
+#include <htslib/vcf.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * Builds a small data set over chromosome 1 of the test fasta and runs the graphite binary on it. There
+ * are two bams with one sample each and a third bam with two samples in their own read groups. The reads
+ * of sampleA and sampleC match the reference, the reads of sampleB and sampleD carry the alternate allele
+ * of every variant. The vcf has a snp every 300 bases so each one is its own cluster, only sampleA has a
+ * column in it so the other samples' columns are added by graphite.
+ */
+class GraphiteRunTest : public ::testing::Test
+{
+public:
+	static void SetUpTestCase()
+	{
+		char directoryTemplate[] = "/tmp/graphite_tests_XXXXXX";
+		s_directory = mkdtemp(directoryTemplate);
+		s_reference = readReference();
+		s_vcf_path = s_directory + "/variants.vcf";
+		writeVCF(s_vcf_path, getVariantPositions());
+		auto alternateBases = getAlternateBases(getVariantPositions());
+		s_bam_paths.clear();
+		s_bam_paths.emplace_back(s_directory + "/sampleA.bam");
+		writeBam(s_bam_paths.back(), { { "sampleA", {} } });
+		s_bam_paths.emplace_back(s_directory + "/sampleB.bam");
+		writeBam(s_bam_paths.back(), { { "sampleB", alternateBases } });
+		s_bam_paths.emplace_back(s_directory + "/sampleC_sampleD.bam");
+		writeBam(s_bam_paths.back(), { { "sampleC", {} }, { "sampleD", alternateBases } });
+	}
+
+	static void TearDownTestCase()
+	{
+		std::string command = "rm -rf " + s_directory;
+		system(command.c_str());
+		s_default_output_directory.clear();
+	}
+
+protected:
+	// the column names of a vcf's header and its records
+	struct VCFRecords
+	{
+		std::vector< std::string > m_column_names;
+		std::vector< std::string > m_records;
+	};
+
+	// a snp and its comma separated alternate bases
+	struct TestVariant
+	{
+		uint32_t m_position;
+		std::string m_alternates;
+	};
+
+	// a bam sample and the base its reads carry at each one based position that differs from the reference
+	struct TestSample
+	{
+		std::string m_name;
+		std::unordered_map< uint32_t, char > m_alternate_bases;
+	};
+
+	static std::vector< uint32_t > getVariantPositions()
+	{
+		return { 700, 1000, 1300, 1600, 1900, 2200, 2500, 2800 };
+	}
+
+	// the samples in column order, sampleA is the vcf's own column and the others follow in bam and read group order
+	static std::vector< std::string > getSampleNames()
+	{
+		return { "sampleA", "sampleB", "sampleC", "sampleD" };
+	}
+
+	// the samples whose reads carry the alternate alleles
+	static bool isAlternateSample(const std::string& sampleName)
+	{
+		return sampleName == "sampleB" || sampleName == "sampleD";
+	}
+
+	static char getAlternateBase(char referenceBase)
+	{
+		switch (referenceBase)
+		{
+		case 'A': return 'G';
+		case 'C': return 'T';
+		case 'G': return 'A';
+		default: return 'C';
+		}
+	}
+
+	static std::unordered_map< uint32_t, char > getAlternateBases(const std::vector< uint32_t >& positions)
+	{
+		std::unordered_map< uint32_t, char > alternateBases;
+		for (auto position : positions)
+		{
+			alternateBases.emplace(position, getAlternateBase(s_reference[position - 1]));
+		}
+		return alternateBases;
+	}
+
+	static std::string readReference()
+	{
+		std::ifstream fastaStream(TEST_FASTA_FILE);
+		std::string line;
+		std::string reference;
+		while (std::getline(fastaStream, line))
+		{
+			if (line.size() > 0 && line[0] != '>')
+			{
+				reference += line;
+			}
+		}
+		return reference;
+	}
+
+	static void writeVCF(const std::string& path, const std::vector< uint32_t >& positions)
+	{
+		std::vector< TestVariant > testVariants;
+		for (auto position : positions)
+		{
+			testVariants.push_back({ position, std::string(1, getAlternateBase(s_reference[position - 1])) });
+		}
+		writeVCF(path, testVariants);
+	}
+
+	static void writeVCF(const std::string& path, const std::vector< TestVariant >& testVariants)
+	{
+		std::ofstream vcfStream(path);
+		vcfStream << "##fileformat=VCFv4.1" << std::endl;
+		vcfStream << "##contig=<ID=1,length=" << s_reference.size() << ">" << std::endl;
+		vcfStream << "##FORMAT=<ID=GT,Number=1,Type=String,Description=\"Genotype\">" << std::endl;
+		vcfStream << "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO\tFORMAT\tsampleA" << std::endl;
+		for (auto& testVariant : testVariants)
+		{
+			vcfStream << "1\t" << testVariant.m_position << "\tvar" << testVariant.m_position << "\t" << s_reference[testVariant.m_position - 1] << "\t" << testVariant.m_alternates << "\t.\tPASS\t.\tGT\t0/0" << std::endl;
+		}
+	}
+
+	// bgzips a vcf with htslib and builds its tabix index
+	static void writeBgzippedVCF(const std::string& vcfPath, const std::string& bgzippedPath)
+	{
+		std::ifstream vcfStream(vcfPath);
+		std::string vcfText((std::istreambuf_iterator< char >(vcfStream)), std::istreambuf_iterator< char >());
+		BGZF* bgzfPtr = bgzf_open(bgzippedPath.c_str(), "w");
+		ASSERT_NE(nullptr, bgzfPtr);
+		EXPECT_EQ((ssize_t)vcfText.size(), bgzf_write(bgzfPtr, vcfText.data(), vcfText.size()));
+		EXPECT_EQ(0, bgzf_close(bgzfPtr));
+		EXPECT_EQ(0, tbx_index_build(bgzippedPath.c_str(), 0, &tbx_conf_vcf));
+	}
+
+	// encodes a vcf as bcf with htslib and builds its csi index
+	static void writeBCF(const std::string& vcfPath, const std::string& bcfPath)
+	{
+		htsFile* vcfFilePtr = hts_open(vcfPath.c_str(), "r");
+		htsFile* bcfFilePtr = hts_open(bcfPath.c_str(), "wb");
+		ASSERT_NE(nullptr, vcfFilePtr);
+		ASSERT_NE(nullptr, bcfFilePtr);
+		bcf_hdr_t* headerPtr = bcf_hdr_read(vcfFilePtr);
+		ASSERT_NE(nullptr, headerPtr);
+		EXPECT_EQ(0, bcf_hdr_write(bcfFilePtr, headerPtr));
+		bcf1_t* recordPtr = bcf_init();
+		while (bcf_read(vcfFilePtr, headerPtr, recordPtr) >= 0)
+		{
+			EXPECT_EQ(0, bcf_write(bcfFilePtr, headerPtr, recordPtr));
+		}
+		bcf_destroy(recordPtr);
+		bcf_hdr_destroy(headerPtr);
+		hts_close(vcfFilePtr);
+		EXPECT_EQ(0, hts_close(bcfFilePtr));
+		EXPECT_EQ(0, bcf_index_build(bcfPath.c_str(), 14));
+	}
+
+	/*
+	 * Tiles the chromosome with 100 base reads on alternating strands for every sample, each sample has its own
+	 * read group and its reads carry its alternate bases. The bam is indexed after it is written.
+	 */
+	static void writeBam(const std::string& path, const std::vector< TestSample >& testSamples)
+	{
+		const uint32_t readLength = 100;
+		std::string headerText = "@HD\tVN:1.4\tSO:coordinate\n@SQ\tSN:1\tLN:" + std::to_string(s_reference.size()) + "\n";
+		std::vector< std::string > sequences;
+		for (auto& testSample : testSamples)
+		{
+			headerText += "@RG\tID:rg_" + testSample.m_name + "\tSM:" + testSample.m_name + "\n";
+			sequences.emplace_back(s_reference);
+			for (auto& alternateBase : testSample.m_alternate_bases)
+			{
+				sequences.back()[alternateBase.first - 1] = alternateBase.second;
+			}
+		}
+		BamTools::RefVector references = { BamTools::RefData("1", s_reference.size()) };
+		BamTools::BamWriter bamWriter;
+		ASSERT_TRUE(bamWriter.Open(path, headerText, references));
+		uint32_t readIndex = 0;
+		for (uint32_t start = 150; start + readLength < s_reference.size() - 150; start += 6)
+		{
+			for (size_t i = 0; i < testSamples.size(); ++i)
+			{
+				BamTools::BamAlignment bamAlignment;
+				bamAlignment.Name = testSamples[i].m_name + "_read" + std::to_string(readIndex);
+				bamAlignment.QueryBases = sequences[i].substr(start, readLength);
+				bamAlignment.Qualities = std::string(readLength, 'I');
+				bamAlignment.Length = readLength;
+				bamAlignment.RefID = 0;
+				bamAlignment.Position = start;
+				bamAlignment.MapQuality = 60;
+				bamAlignment.CigarData.emplace_back('M', readLength);
+				bamAlignment.SetIsReverseStrand(readIndex % 2 == 1);
+				bamAlignment.AddTag< std::string >("RG", "Z", "rg_" + testSamples[i].m_name);
+				ASSERT_TRUE(bamWriter.SaveAlignment(bamAlignment));
+			}
+			++readIndex;
+		}
+		bamWriter.Close();
+
+		BamTools::BamReader bamReader;
+		ASSERT_TRUE(bamReader.Open(path));
+		ASSERT_TRUE(bamReader.CreateIndex(BamTools::BamIndex::STANDARD));
+		bamReader.Close();
+	}
+
+	// copies a bam record by record into a cram encoded against the test fasta and indexes it
+	static void writeCram(const std::string& bamPath, const std::string& cramPath)
+	{
+		htsFile* bamFilePtr = hts_open(bamPath.c_str(), "r");
+		htsFile* cramFilePtr = hts_open(cramPath.c_str(), "wc");
+		ASSERT_NE(nullptr, bamFilePtr);
+		ASSERT_NE(nullptr, cramFilePtr);
+		ASSERT_EQ(0, hts_set_fai_filename(cramFilePtr, TEST_FASTA_FILE));
+		bam_hdr_t* headerPtr = sam_hdr_read(bamFilePtr);
+		ASSERT_NE(nullptr, headerPtr);
+		EXPECT_EQ(0, sam_hdr_write(cramFilePtr, headerPtr));
+		bam1_t* recordPtr = bam_init1();
+		size_t recordCount = 0;
+		while (sam_read1(bamFilePtr, headerPtr, recordPtr) >= 0)
+		{
+			EXPECT_LE(0, sam_write1(cramFilePtr, headerPtr, recordPtr));
+			++recordCount;
+		}
+		EXPECT_LT(0, recordCount);
+		bam_destroy1(recordPtr);
+		bam_hdr_destroy(headerPtr);
+		hts_close(bamFilePtr);
+		EXPECT_EQ(0, hts_close(cramFilePtr));
+		EXPECT_EQ(0, sam_index_build(cramPath.c_str(), 0));
+	}
+
+	/*
+	 * Runs graphite on the vcfs and bams with the extra arguments into a new directory under the test
+	 * directory and returns the directory, the run's output is logged to graphite.log in it.
+	 */
+	static std::string runGraphite(const std::string& runName, const std::vector< std::string >& vcfPaths, const std::vector< std::string >& bamPaths, const std::string& arguments, int& exitStatus)
+	{
+		std::string outputDirectory = s_directory + "/" + runName;
+		mkdir(outputDirectory.c_str(), 0755);
+		std::string command = std::string(TEST_GRAPHITE_BINARY) + " -f " + TEST_FASTA_FILE + " -o " + outputDirectory;
+		for (auto& vcfPath : vcfPaths)
+		{
+			command += " -v " + vcfPath;
+		}
+		for (auto& bamPath : bamPaths)
+		{
+			command += " -b " + bamPath;
+		}
+		command += " " + arguments + " > " + outputDirectory + "/graphite.log 2>&1";
+		exitStatus = system(command.c_str());
+		return outputDirectory;
+	}
+
+	static std::string runGraphite(const std::string& runName, const std::vector< std::string >& vcfPaths, const std::vector< std::string >& bamPaths, const std::string& arguments)
+	{
+		int exitStatus = 0;
+		auto outputDirectory = runGraphite(runName, vcfPaths, bamPaths, arguments, exitStatus);
+		EXPECT_EQ(0, exitStatus) << "graphite " << arguments << " failed, see " << outputDirectory << "/graphite.log";
+		return outputDirectory;
+	}
+
+	static std::string runGraphite(const std::string& runName, const std::string& arguments)
+	{
+		return runGraphite(runName, { s_vcf_path }, s_bam_paths, arguments);
+	}
+
+	// the output of a run without optional arguments, the other runs are compared against it
+	static std::string getDefaultVCFPath()
+	{
+		if (s_default_output_directory.empty())
+		{
+			s_default_output_directory = runGraphite("default", "");
+		}
+		return s_default_output_directory + "/variants.vcf";
+	}
+
+	// plain, gzipped or bcf
+	static VCFRecords readVCF(const std::string& path)
+	{
+		if (graphite::VCFFileWriter::isBCFPath(path))
+		{
+			return readBCF(path);
+		}
+		VCFRecords vcfRecords;
+		graphite::LineReader lineReader(path);
+		EXPECT_TRUE(lineReader.isOpen()) << "unable to open " << path;
+		graphite::StringView line;
+		while (lineReader.getNextLine(line))
+		{
+			if (line.size() > 1 && line[0] == '#' && line[1] != '#')
+			{
+				vcfRecords.m_column_names = splitColumns(line.toString(), '\t');
+			}
+			else if (line.size() > 0 && line[0] != '#')
+			{
+				vcfRecords.m_records.emplace_back(line.toString());
+			}
+		}
+		return vcfRecords;
+	}
+
+	// the bcf's header and records are formatted as vcf text by htslib
+	static VCFRecords readBCF(const std::string& path)
+	{
+		VCFRecords vcfRecords;
+		htsFile* bcfFilePtr = hts_open(path.c_str(), "r");
+		bcf_hdr_t* headerPtr = (bcfFilePtr != nullptr) ? bcf_hdr_read(bcfFilePtr) : nullptr;
+		EXPECT_NE(nullptr, headerPtr) << "unable to open " << path;
+		if (headerPtr == nullptr)
+		{
+			if (bcfFilePtr != nullptr)
+			{
+				hts_close(bcfFilePtr);
+			}
+			return vcfRecords;
+		}
+		kstring_t text = {0, 0, nullptr};
+		bcf_hdr_format(headerPtr, 0, &text);
+		for (auto& headerLine : splitColumns(std::string(text.s, text.l), '\n'))
+		{
+			if (headerLine.size() > 1 && headerLine[0] == '#' && headerLine[1] != '#')
+			{
+				vcfRecords.m_column_names = splitColumns(headerLine, '\t');
+			}
+		}
+		bcf1_t* recordPtr = bcf_init();
+		while (bcf_read(bcfFilePtr, headerPtr, recordPtr) >= 0)
+		{
+			text.l = 0;
+			EXPECT_EQ(0, vcf_format(headerPtr, recordPtr, &text));
+			size_t lineSize = (text.l > 0 && text.s[text.l - 1] == '\n') ? text.l - 1 : text.l;
+			vcfRecords.m_records.emplace_back(text.s, lineSize);
+		}
+		free(text.s);
+		bcf_destroy(recordPtr);
+		bcf_hdr_destroy(headerPtr);
+		hts_close(bcfFilePtr);
+		return vcfRecords;
+	}
+
+	static std::vector< std::string > splitColumns(const std::string& text, char delimiter)
+	{
+		std::vector< graphite::StringView > fieldViews;
+		graphite::Tokenizer::split(graphite::StringView(text.c_str(), text.size()), delimiter, fieldViews);
+		std::vector< std::string > fields;
+		for (auto& fieldView : fieldViews)
+		{
+			fields.emplace_back(fieldView.toString());
+		}
+		return fields;
+	}
+
+	// the value of a FORMAT field in a sample's column of a record, empty when the record doesn't have it
+	static std::string getSampleField(const VCFRecords& vcfRecords, size_t recordIndex, const std::string& sampleName, const std::string& fieldName)
+	{
+		auto columns = splitColumns(vcfRecords.m_records[recordIndex], '\t');
+		auto formatIter = std::find(vcfRecords.m_column_names.begin(), vcfRecords.m_column_names.end(), "FORMAT");
+		auto sampleIter = std::find(vcfRecords.m_column_names.begin(), vcfRecords.m_column_names.end(), sampleName);
+		if (formatIter == vcfRecords.m_column_names.end() || sampleIter == vcfRecords.m_column_names.end())
+		{
+			return "";
+		}
+		auto formatFields = splitColumns(columns[formatIter - vcfRecords.m_column_names.begin()], ':');
+		auto sampleFields = splitColumns(columns[sampleIter - vcfRecords.m_column_names.begin()], ':');
+		auto fieldIter = std::find(formatFields.begin(), formatFields.end(), fieldName);
+		size_t fieldIndex = fieldIter - formatFields.begin();
+		return (fieldIndex < sampleFields.size()) ? sampleFields[fieldIndex] : "";
+	}
+
+	// the DP4 field of a sample as numbers, reference forward and reverse then each alternate forward and reverse
+	static std::vector< uint32_t > getSampleCounts(const VCFRecords& vcfRecords, size_t recordIndex, const std::string& sampleName, const std::string& fieldName)
+	{
+		std::vector< uint32_t > counts;
+		for (auto& countField : splitColumns(getSampleField(vcfRecords, recordIndex, sampleName, fieldName), ','))
+		{
+			uint32_t count = 0;
+			EXPECT_TRUE(graphite::Tokenizer::parseUnsigned(graphite::StringView(countField.c_str(), countField.size()), count)) << fieldName << " of " << sampleName << " is not a count: " << countField;
+			counts.emplace_back(count);
+		}
+		return counts;
+	}
+
+	static void expectSameVCF(const std::string& expectedPath, const std::string& actualPath)
+	{
+		auto expectedRecords = readVCF(expectedPath);
+		auto actualRecords = readVCF(actualPath);
+		EXPECT_EQ(expectedRecords.m_column_names, actualRecords.m_column_names);
+		ASSERT_EQ(expectedRecords.m_records.size(), actualRecords.m_records.size());
+		for (size_t i = 0; i < expectedRecords.m_records.size(); ++i)
+		{
+			EXPECT_EQ(expectedRecords.m_records[i], actualRecords.m_records[i]);
+		}
+	}
+
+	static std::string s_directory;
+	static std::string s_reference;
+	static std::string s_vcf_path;
+	static std::vector< std::string > s_bam_paths;
+	static std::string s_default_output_directory;
+};
+
+std::string GraphiteRunTest::s_directory;
+std::string GraphiteRunTest::s_reference;
+std::string GraphiteRunTest::s_vcf_path;
+std::vector< std::string > GraphiteRunTest::s_bam_paths;
+std::string GraphiteRunTest::s_default_output_directory;
+
+#endif //GRAPHITE_TESTS_GRAPHITERUNFIXTURE_HPP
@@ -0,0 +1,322 @@
+#ifndef GRAPHITE_TESTS_GRAPHITERUN_HPP
+#define GRAPHITE_TESTS_GRAPHITERUN_HPP
+
+#include "GraphiteRunFixture.hpp"
+
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <unordered_map>
+
+TEST_F(GraphiteRunTest, DefaultRunWritesEveryVariant)
+{
+	auto vcfRecords = readVCF(getDefaultVCFPath());
+	EXPECT_EQ(getVariantPositions().size(), vcfRecords.m_records.size());
+	auto sampleNames = getSampleNames();
+	std::vector< std::string > sampleColumnNames(vcfRecords.m_column_names.begin() + 9, vcfRecords.m_column_names.end());
+	EXPECT_EQ(sampleNames, sampleColumnNames);
+}
+
+/*
+ * The writers plan their columns from the sample indices, so every sample needs its index before the header is written.
+ * Shards and worker processes open their own bams, the records of every shard have to line up under the first shard's header.
+ */
+TEST_F(GraphiteRunTest, EverySampleColumnGetsItsOwnCounts)
+{
+	std::vector< std::string > vcfPaths = {
+		getDefaultVCFPath(),
+		runGraphite("sample_columns_shards_8", "-n 8 -t 4") + "/variants.vcf",
+		runGraphite("sample_columns_workers_2", "-w 2 -n 8") + "/variants.vcf"
+	};
+	for (auto& vcfPath : vcfPaths)
+	{
+		auto vcfRecords = readVCF(vcfPath);
+		ASSERT_EQ(getVariantPositions().size(), vcfRecords.m_records.size()) << vcfPath;
+		for (size_t i = 0; i < vcfRecords.m_records.size(); ++i)
+		{
+			for (auto& sampleName : getSampleNames())
+			{
+				auto sampleCounts = getSampleCounts(vcfRecords, i, sampleName, "DP4_NFP");
+				ASSERT_EQ(4, sampleCounts.size()) << sampleName << " in " << vcfPath;
+				uint32_t referenceCount = sampleCounts[0] + sampleCounts[1];
+				uint32_t alternateCount = sampleCounts[2] + sampleCounts[3];
+				if (isAlternateSample(sampleName))
+				{
+					EXPECT_GT(alternateCount, referenceCount) << sampleName << " in " << vcfPath << ": " << vcfRecords.m_records[i];
+				}
+				else
+				{
+					EXPECT_GT(referenceCount, alternateCount) << sampleName << " in " << vcfPath << ": " << vcfRecords.m_records[i];
+				}
+			}
+		}
+	}
+}
+
+// the counts are accumulated in per-worker shards and merged when a variant is written
+TEST_F(GraphiteRunTest, ThreadCountDoesNotChangeCounts)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("threads_1", "-t 1") + "/variants.vcf");
+	expectSameVCF(defaultVCFPath, runGraphite("threads_8", "-t 8") + "/variants.vcf");
+}
+
+// shards are merged back in input order, with more shards than variants every variant is its own shard
+TEST_F(GraphiteRunTest, ShardedRunsMatchDefault)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("shards_3", "-n 3") + "/variants.vcf");
+	expectSameVCF(defaultVCFPath, runGraphite("shards_20", "-n 20 -t 4") + "/variants.vcf");
+}
+
+// the clusters' fetch regions overlap so the window of decoded reads is extended and evicted from cluster to cluster,
+// a region starts the window part way through the chromosome
+TEST_F(GraphiteRunTest, RegionRunMatchesDefaultRecords)
+{
+	auto defaultRecords = readVCF(getDefaultVCFPath());
+	auto regionRecords = readVCF(runGraphite("region", "-r 1:1500-2600") + "/variants.vcf");
+	std::vector< std::string > expectedRecords;
+	for (auto& record : defaultRecords.m_records)
+	{
+		uint32_t position = std::stoul(splitColumns(record, '\t')[1]);
+		if (1500 <= position && position <= 2600)
+		{
+			expectedRecords.emplace_back(record);
+		}
+	}
+	EXPECT_EQ(4, expectedRecords.size());
+	EXPECT_EQ(expectedRecords, regionRecords.m_records);
+}
+
+// an indexed input is read through tabix, the region and every shard's regions are seeked to instead of read up to
+TEST_F(GraphiteRunTest, TabixIndexedInputMatchesPlainInput)
+{
+	std::string indexedVCFPath = s_directory + "/variants_indexed.vcf.gz";
+	writeBgzippedVCF(s_vcf_path, indexedVCFPath);
+	// the outputs keep the input's name but are plain text without --bgzip_threads, readVCF reads them either way
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("indexed", { indexedVCFPath }, s_bam_paths, "") + "/variants_indexed.vcf.gz");
+	expectSameVCF(defaultVCFPath, runGraphite("indexed_shards_3", { indexedVCFPath }, s_bam_paths, "-n 3") + "/variants_indexed.vcf.gz");
+
+	auto plainRegionVCFPath = runGraphite("plain_region", "-r 1:1500-2600") + "/variants.vcf";
+	auto indexedRegionVCFPath = runGraphite("indexed_region", { indexedVCFPath }, s_bam_paths, "-r 1:1500-2600") + "/variants_indexed.vcf.gz";
+	EXPECT_EQ(4, readVCF(indexedRegionVCFPath).m_records.size());
+	expectSameVCF(plainRegionVCFPath, indexedRegionVCFPath);
+}
+
+// a bcf input is decoded into vcf lines and its output is encoded back to bcf, the records survive both ways
+TEST_F(GraphiteRunTest, BCFRunsMatchDefault)
+{
+	std::string bcfPath = s_directory + "/variants.bcf";
+	writeBCF(s_vcf_path, bcfPath);
+	auto defaultVCFPath = getDefaultVCFPath();
+	std::vector< std::string > outputPaths = {
+		runGraphite("bcf", { bcfPath }, s_bam_paths, "") + "/variants.bcf",
+		runGraphite("bcf_shards_3", { bcfPath }, s_bam_paths, "-n 3 --bgzip_threads 2") + "/variants.bcf"
+	};
+	for (auto& outputPath : outputPaths)
+	{
+		EXPECT_EQ(0, access((outputPath + ".csi").c_str(), F_OK)) << outputPath << " has no index";
+		expectSameVCF(defaultVCFPath, outputPath);
+	}
+}
+
+// the bgzipped output is written and indexed on the compression threads, plain shards are compressed as they are merged
+TEST_F(GraphiteRunTest, BgzippedOutputMatchesDefault)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	std::vector< std::string > outputPaths = {
+		runGraphite("bgzip", "--bgzip_threads 2") + "/variants.vcf.gz",
+		runGraphite("bgzip_shards_3", "--bgzip_threads 2 -n 3") + "/variants.vcf.gz"
+	};
+	for (auto& outputPath : outputPaths)
+	{
+		EXPECT_EQ(0, access((outputPath + ".tbi").c_str(), F_OK)) << outputPath << " has no index";
+		expectSameVCF(defaultVCFPath, outputPath);
+	}
+}
+
+// a sweep reads each bam front to back instead of fetching every cluster's region
+TEST_F(GraphiteRunTest, SweepRunsMatchDefault)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("sweep", "--sweep") + "/variants.vcf");
+	expectSameVCF(defaultVCFPath, runGraphite("sweep_shards_3", "--sweep -n 3") + "/variants.vcf");
+}
+
+// with decompression threads the bams are read with htslib instead of bamtools, crams are always read with htslib
+TEST_F(GraphiteRunTest, HTSReaderRunsMatchDefault)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("decompression_threads_2", "--decompression_threads 2") + "/variants.vcf");
+
+	std::vector< std::string > cramPaths;
+	for (auto& bamPath : s_bam_paths)
+	{
+		cramPaths.emplace_back(bamPath.substr(0, bamPath.size() - 4) + ".cram");
+		writeCram(bamPath, cramPaths.back());
+	}
+	expectSameVCF(defaultVCFPath, runGraphite("cram", { s_vcf_path }, cramPaths, "") + "/variants.vcf");
+	expectSameVCF(defaultVCFPath, runGraphite("cram_shards_3", { s_vcf_path }, cramPaths, "-n 3 --decompression_threads 2") + "/variants.vcf");
+}
+
+// a cap above the coverage keeps every read, the output only gains the DSF field
+TEST_F(GraphiteRunTest, MaxDepthAboveCoverageKeepsEveryRead)
+{
+	auto defaultRecords = readVCF(getDefaultVCFPath());
+	auto cappedRecords = readVCF(runGraphite("max_depth_10000", "--max_depth 10000") + "/variants.vcf");
+	EXPECT_EQ(defaultRecords.m_column_names, cappedRecords.m_column_names);
+	ASSERT_EQ(defaultRecords.m_records.size(), cappedRecords.m_records.size());
+	for (size_t i = 0; i < defaultRecords.m_records.size(); ++i)
+	{
+		auto formatFields = splitColumns(splitColumns(defaultRecords.m_records[i], '\t')[8], ':');
+		EXPECT_EQ(splitColumns(defaultRecords.m_records[i], '\t')[8] + ":DSF", splitColumns(cappedRecords.m_records[i], '\t')[8]);
+		for (auto& sampleName : getSampleNames())
+		{
+			for (auto& formatField : formatFields)
+			{
+				EXPECT_EQ(getSampleField(defaultRecords, i, sampleName, formatField), getSampleField(cappedRecords, i, sampleName, formatField)) << formatField << " of " << sampleName << " in " << cappedRecords.m_records[i];
+			}
+			EXPECT_EQ("1.000000", getSampleField(cappedRecords, i, sampleName, "DSF"));
+		}
+	}
+}
+
+// a small cap bounds the reads counted for every sample, the same reads are kept when the run is sharded
+TEST_F(GraphiteRunTest, MaxDepthBoundsEverySample)
+{
+	const uint32_t maxDepth = 10;
+	auto cappedVCFPath = runGraphite("max_depth_10", "--max_depth " + std::to_string(maxDepth)) + "/variants.vcf";
+	auto cappedRecords = readVCF(cappedVCFPath);
+	ASSERT_EQ(getVariantPositions().size(), cappedRecords.m_records.size());
+	for (size_t i = 0; i < cappedRecords.m_records.size(); ++i)
+	{
+		for (auto& sampleName : getSampleNames())
+		{
+			uint32_t countedReads = 0;
+			for (auto fieldName : { "DP4_NFP", "DP4_NP", "DP4_EP", "DP4_SP", "DP4_LP", "DP4_AP" })
+			{
+				for (auto count : getSampleCounts(cappedRecords, i, sampleName, fieldName))
+				{
+					countedReads += count;
+				}
+			}
+			EXPECT_LE(countedReads, maxDepth) << sampleName << " in " << cappedRecords.m_records[i];
+			float downsampleFraction = std::stof(getSampleField(cappedRecords, i, sampleName, "DSF"));
+			EXPECT_LT(0.0f, downsampleFraction);
+			EXPECT_GT(1.0f, downsampleFraction);
+		}
+	}
+	expectSameVCF(cappedVCFPath, runGraphite("max_depth_10_shards_3", "--max_depth " + std::to_string(maxDepth) + " -n 3 -t 4") + "/variants.vcf");
+}
+
+// variants of different vcfs that are close together are adjudicated in one cluster, the same as when they share a vcf
+TEST_F(GraphiteRunTest, SplitVCFsMatchCombinedVCF)
+{
+	auto positions = getVariantPositions();
+	positions.emplace_back(1010); // shares a cluster with the variant at 1000
+	std::sort(positions.begin(), positions.end());
+	std::vector< uint32_t > firstPositions;
+	std::vector< uint32_t > secondPositions;
+	for (size_t i = 0; i < positions.size(); ++i)
+	{
+		((i % 2 == 0) ? firstPositions : secondPositions).emplace_back(positions[i]);
+	}
+	std::string combinedVCFPath = s_directory + "/combined.vcf";
+	std::vector< std::string > splitVCFPaths = { s_directory + "/split_first.vcf", s_directory + "/split_second.vcf" };
+	writeVCF(combinedVCFPath, positions);
+	writeVCF(splitVCFPaths[0], firstPositions);
+	writeVCF(splitVCFPaths[1], secondPositions);
+
+	auto combinedRecords = readVCF(runGraphite("combined", { combinedVCFPath }, s_bam_paths, "") + "/combined.vcf");
+	ASSERT_EQ(positions.size(), combinedRecords.m_records.size());
+	std::unordered_map< std::string, std::string > combinedRecordsByPosition;
+	for (auto& record : combinedRecords.m_records)
+	{
+		combinedRecordsByPosition.emplace(splitColumns(record, '\t')[1], record);
+	}
+
+	std::vector< std::string > outputDirectories = {
+		runGraphite("split", splitVCFPaths, s_bam_paths, ""),
+		runGraphite("split_shards_3", splitVCFPaths, s_bam_paths, "-n 3")
+	};
+	for (auto& outputDirectory : outputDirectories)
+	{
+		std::string firstOutputPath = outputDirectory + "/split_first.vcf";
+		std::string secondOutputPath = outputDirectory + "/split_second.vcf";
+		std::vector< std::pair< std::string, size_t > > outputPathRecordCounts = { { firstOutputPath, firstPositions.size() }, { secondOutputPath, secondPositions.size() } };
+		for (auto& outputPathRecordCount : outputPathRecordCounts)
+		{
+			auto splitRecords = readVCF(outputPathRecordCount.first);
+			EXPECT_EQ(combinedRecords.m_column_names, splitRecords.m_column_names);
+			EXPECT_EQ(outputPathRecordCount.second, splitRecords.m_records.size()) << outputPathRecordCount.first;
+			for (auto& record : splitRecords.m_records)
+			{
+				EXPECT_EQ(combinedRecordsByPosition[splitColumns(record, '\t')[1]], record) << outputPathRecordCount.first;
+			}
+		}
+	}
+}
+
+/*
+ * Both vcfs have the snp at 1600, the second one with an extra alternate and a snp at 1601 right after it. The shared
+ * alternate gets one node, which still needs its edge to the next snp's node so reads that carry both alternates align
+ * through them instead of through one alternate and a mismatching reference base.
+ */
+TEST_F(GraphiteRunTest, SharedAlternateConnectsToTheAdjacentVariant)
+{
+	const uint32_t position = 1600;
+	char referenceBase = s_reference[position - 1];
+	char sharedBase = getAlternateBase(referenceBase);
+	std::string bases = "ACGT";
+	char otherBase = *std::find_if(bases.begin(), bases.end(), [&](char base) { return base != referenceBase && base != sharedBase; });
+	char adjacentBase = getAlternateBase(s_reference[position]);
+	std::string firstVCFPath = s_directory + "/shared_first.vcf";
+	std::string secondVCFPath = s_directory + "/shared_second.vcf";
+	writeVCF(firstVCFPath, std::vector< TestVariant >{ { position, std::string(1, sharedBase) } });
+	writeVCF(secondVCFPath, std::vector< TestVariant >{ { position, std::string(1, sharedBase) + "," + otherBase }, { position + 1, std::string(1, adjacentBase) } });
+	std::string bamPath = s_directory + "/sampleE.bam";
+	writeBam(bamPath, { { "sampleE", { { position, sharedBase }, { position + 1, adjacentBase } } } });
+
+	auto outputDirectory = runGraphite("shared_alternate", { firstVCFPath, secondVCFPath }, { bamPath }, "");
+	auto firstRecords = readVCF(outputDirectory + "/shared_first.vcf");
+	auto secondRecords = readVCF(outputDirectory + "/shared_second.vcf");
+	ASSERT_EQ(1, firstRecords.m_records.size());
+	ASSERT_EQ(2, secondRecords.m_records.size());
+	// the reads carry the first alternate of every record
+	std::vector< std::pair< const VCFRecords*, size_t > > recordIndices = { { &firstRecords, 0 }, { &secondRecords, 0 }, { &secondRecords, 1 } };
+	for (auto& recordIndex : recordIndices)
+	{
+		auto sampleCounts = getSampleCounts(*recordIndex.first, recordIndex.second, "sampleE", "DP4_NFP");
+		ASSERT_LE(4, sampleCounts.size());
+		uint32_t otherCount = 0;
+		for (size_t i = 0; i < sampleCounts.size(); ++i)
+		{
+			otherCount += (i == 2 || i == 3) ? 0 : sampleCounts[i];
+		}
+		EXPECT_GT(sampleCounts[2] + sampleCounts[3], otherCount) << recordIndex.first->m_records[recordIndex.second];
+	}
+}
+
+TEST_F(GraphiteRunTest, WorkerProcessRunsMatchDefault)
+{
+	auto defaultVCFPath = getDefaultVCFPath();
+	expectSameVCF(defaultVCFPath, runGraphite("workers_2", "-w 2") + "/variants.vcf");
+	expectSameVCF(defaultVCFPath, runGraphite("workers_3_units_5", "-w 3 -n 5") + "/variants.vcf");
+}
+
+// a file where the first unit's output directory goes makes every attempt at that unit fail
+TEST_F(GraphiteRunTest, FailedWorkUnitIsRetriedThenTheRunFails)
+{
+	std::string outputDirectory = s_directory + "/workers_failing";
+	mkdir(outputDirectory.c_str(), 0755);
+	std::ofstream(outputDirectory + "/graphite_shard_0") << "not a directory" << std::endl;
+	int exitStatus = 0;
+	runGraphite("workers_failing", { s_vcf_path }, s_bam_paths, "-w 2 -n 4", exitStatus);
+	EXPECT_NE(0, exitStatus);
+	std::ifstream logStream(outputDirectory + "/graphite.log");
+	std::string log((std::istreambuf_iterator< char >(logStream)), std::istreambuf_iterator< char >());
+	EXPECT_NE(std::string::npos, log.find("Work unit 0 failed after 3 attempts")) << log;
+}
+
+#endif //GRAPHITE_TESTS_GRAPHITERUN_HPP
@@ -0,0 +1,136 @@
+#ifndef GRAPHITE_TESTS_LINEREADER_HPP
+#define GRAPHITE_TESTS_LINEREADER_HPP
+
+#include "core/util/LineReader.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <unistd.h>
+#include <zlib.h>
+
+namespace
+{
+	const size_t LINE_READER_BLOCK_SIZE = 4 * 1024 * 1024; // LineReader's BLOCK_SIZE
+
+	/*
+	 * Lines that land on the reader's block boundaries: a '\n' is the last byte of the first block,
+	 * a line spans the second boundary, a line is longer than a whole block and an empty line
+	 * follows it. The last line has no '\n'.
+	 */
+	std::vector< std::string > getBlockBoundaryLines()
+	{
+		std::vector< std::string > lines;
+		size_t size = 0;
+		auto addLine = [&](const std::string& line)
+		{
+			lines.emplace_back(line);
+			size += line.size() + 1;
+		};
+		for (size_t i = 0; size + 1000 < LINE_READER_BLOCK_SIZE; ++i)
+		{
+			addLine(std::to_string(i) + "\t" + std::string(i % 300, 'a' + (i % 26)));
+		}
+		addLine(std::string(LINE_READER_BLOCK_SIZE - size - 1, 'b')); // its '\n' is the block's last byte
+		addLine("first line of the second block");
+		addLine(std::string((2 * LINE_READER_BLOCK_SIZE) - size + 10, 'c')); // ends ten bytes into the third block
+		addLine(std::string(LINE_READER_BLOCK_SIZE + 12345, 'd'));
+		addLine("");
+		addLine("last line");
+		return lines;
+	}
+
+	std::string getLineReaderTestPath(const std::string& extension)
+	{
+		char directoryTemplate[] = "/tmp/graphite_line_reader_XXXXXX";
+		return std::string(mkdtemp(directoryTemplate)) + "/lines" + extension;
+	}
+
+	void writeLines(const std::string& path, const std::vector< std::string >& lines)
+	{
+		std::string text;
+		for (size_t i = 0; i < lines.size(); ++i)
+		{
+			text += lines[i] + ((i + 1 < lines.size()) ? "\n" : "");
+		}
+		if (path.substr(path.size() - 3) == ".gz")
+		{
+			gzFile gzFilePtr = gzopen(path.c_str(), "wb");
+			ASSERT_TRUE(gzFilePtr != nullptr);
+			ASSERT_EQ((int)text.size(), gzwrite(gzFilePtr, text.data(), text.size()));
+			ASSERT_EQ(Z_OK, gzclose(gzFilePtr));
+		}
+		else
+		{
+			std::ofstream outStream(path);
+			outStream << text;
+		}
+	}
+
+	void expectLines(const std::string& path, const std::vector< std::string >& expectedLines)
+	{
+		graphite::LineReader lineReader(path);
+		ASSERT_TRUE(lineReader.isOpen());
+		graphite::StringView line;
+		size_t lineCount = 0;
+		while (lineReader.getNextLine(line))
+		{
+			ASSERT_LT(lineCount, expectedLines.size());
+			EXPECT_TRUE(line.equals(expectedLines[lineCount])) << path << " line " << lineCount << " has " << line.size() << " bytes, expected " << expectedLines[lineCount].size();
+			++lineCount;
+		}
+		EXPECT_EQ(expectedLines.size(), lineCount);
+		EXPECT_FALSE(lineReader.getNextLine(line));
+	}
+
+	void removeLineReaderTestPath(const std::string& path)
+	{
+		std::string command = "rm -rf " + path.substr(0, path.find_last_of("/"));
+		system(command.c_str());
+	}
+}
+
+TEST(LineReaderTest, PlainFileBlockBoundaries)
+{
+	auto lines = getBlockBoundaryLines();
+	std::string path = getLineReaderTestPath(".txt");
+	writeLines(path, lines);
+	expectLines(path, lines);
+	removeLineReaderTestPath(path);
+}
+
+// gzipped files are decompressed a block at a time, the unfinished line is carried into the next block
+TEST(LineReaderTest, GzippedFileBlockBoundaries)
+{
+	auto lines = getBlockBoundaryLines();
+	std::string path = getLineReaderTestPath(".txt.gz");
+	writeLines(path, lines);
+	expectLines(path, lines);
+	removeLineReaderTestPath(path);
+}
+
+TEST(LineReaderTest, ReadsTestFiles)
+{
+	std::vector< std::string > expectedLines;
+	std::ifstream inStream(TEST_LINE_NUMBERS_FILE);
+	std::string line;
+	while (std::getline(inStream, line))
+	{
+		expectedLines.emplace_back(line);
+	}
+	ASSERT_FALSE(expectedLines.empty());
+	expectLines(TEST_LINE_NUMBERS_FILE, expectedLines);
+	expectLines(TEST_LINE_NUMBERS_GZ_FILE, expectedLines);
+}
+
+TEST(LineReaderTest, MissingFileIsNotOpen)
+{
+	graphite::LineReader lineReader("/tmp/graphite_line_reader_missing.txt");
+	EXPECT_FALSE(lineReader.isOpen());
+	graphite::StringView line;
+	EXPECT_FALSE(lineReader.getNextLine(line));
+}
+
+#endif //GRAPHITE_TESTS_LINEREADER_HPP
@@ -0,0 +1,88 @@
+#ifndef GRAPHITE_TESTS_SHARDPROCESSOR_HPP
+#define GRAPHITE_TESTS_SHARDPROCESSOR_HPP
+
+#include "GraphiteRunFixture.hpp"
+
+#include "core/region/Region.h"
+#include "core/shard/ShardProcessor.h"
+
+#include <string>
+#include <vector>
+
+/*
+ * Cut points of ShardProcessor::partition over the run fixture's bams, whose 100 base reads keep the graph
+ * spacing at 200. A shard closes once it has its share of the variants and the gap to the next one is at
+ * least the graph spacing, so no cluster is split across shards.
+ */
+class ShardPartitionTest : public GraphiteRunTest
+{
+protected:
+	// every shard's regions as "chrom:start-end"
+	static std::vector< std::vector< std::string > > partition(const std::vector< uint32_t >& positions, uint32_t shardCount, graphite::Region::SharedPtr regionPtr)
+	{
+		std::string vcfPath = s_directory + "/" + ::testing::UnitTest::GetInstance()->current_test_info()->name() + ".vcf";
+		writeVCF(vcfPath, positions);
+		graphite::ShardProcessor shardProcessor(TEST_FASTA_FILE, s_bam_paths, { vcfPath }, s_directory, regionPtr, 1, 4, 6, 1, false, false, false, 1, 0, 0);
+		std::vector< std::vector< std::string > > shards;
+		for (auto& regionPtrs : shardProcessor.partition(shardCount))
+		{
+			shards.emplace_back();
+			for (auto& regionPtr : regionPtrs)
+			{
+				shards.back().emplace_back(regionPtr->getReferenceID() + ":" + std::to_string(regionPtr->getStartPosition()) + "-" + std::to_string(regionPtr->getEndPosition()));
+			}
+		}
+		return shards;
+	}
+
+	static std::vector< std::vector< std::string > > partition(const std::vector< uint32_t >& positions, uint32_t shardCount)
+	{
+		return partition(positions, shardCount, nullptr);
+	}
+};
+
+TEST_F(ShardPartitionTest, EvenlySpacedVariantsSplitIntoEqualShards)
+{
+	std::vector< std::vector< std::string > > expectedShards = { { "1:700-1300" }, { "1:1600-2200" }, { "1:2500-2800" } };
+	EXPECT_EQ(expectedShards, partition(getVariantPositions(), 3));
+}
+
+// the shard that reaches its share at 1300 stays open until the gap after 1350
+TEST_F(ShardPartitionTest, ClustersAreNotSplit)
+{
+	std::vector< std::vector< std::string > > expectedShards = { { "1:700-1350" }, { "1:2000-2800" } };
+	EXPECT_EQ(expectedShards, partition({ 700, 750, 800, 1300, 1350, 2000, 2100, 2800 }, 2));
+}
+
+// no shard can close when every gap is shorter than the graph spacing
+TEST_F(ShardPartitionTest, OneClusterIsOneShard)
+{
+	std::vector< std::vector< std::string > > expectedShards = { { "1:700-1150" } };
+	EXPECT_EQ(expectedShards, partition({ 700, 850, 1000, 1150 }, 4));
+}
+
+TEST_F(ShardPartitionTest, MoreShardsThanVariants)
+{
+	auto positions = getVariantPositions();
+	std::vector< std::vector< std::string > > expectedShards;
+	for (auto position : positions)
+	{
+		expectedShards.push_back({ "1:" + std::to_string(position) + "-" + std::to_string(position) });
+	}
+	EXPECT_EQ(expectedShards, partition(positions, 20));
+}
+
+// only the variants inside the region are shared out
+TEST_F(ShardPartitionTest, RegionRestrictsTheVariants)
+{
+	auto regionPtr = std::make_shared< graphite::Region >("1:1500-2600", graphite::Region::BASED::ONE);
+	std::vector< std::vector< std::string > > expectedShards = { { "1:1600-1900" }, { "1:2200-2500" } };
+	EXPECT_EQ(expectedShards, partition(getVariantPositions(), 2, regionPtr));
+}
+
+TEST_F(ShardPartitionTest, NoVariantsNoShards)
+{
+	EXPECT_TRUE(partition({}, 3).empty());
+}
+
+#endif //GRAPHITE_TESTS_SHARDPROCESSOR_HPP
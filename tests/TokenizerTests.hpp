@@ -0,0 +1,107 @@
+#ifndef GRAPHITE_TESTS_TOKENIZER_HPP
+#define GRAPHITE_TESTS_TOKENIZER_HPP
+
+#include "core/util/Tokenizer.hpp"
+
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+namespace
+{
+	std::vector< std::string > splitToStrings(const std::string& text, char delimiter)
+	{
+		std::vector< graphite::StringView > fieldViews;
+		graphite::Tokenizer::split(graphite::StringView(text.c_str(), text.size()), delimiter, fieldViews);
+		std::vector< std::string > fields;
+		for (auto& fieldView : fieldViews)
+		{
+			fields.emplace_back(fieldView.toString());
+		}
+		return fields;
+	}
+
+	template < typename T >
+	bool parseUnsignedString(const std::string& text, T& value)
+	{
+		return graphite::Tokenizer::parseUnsigned(graphite::StringView(text.c_str(), text.size()), value);
+	}
+}
+
+// every position around the sixteen byte steps, so the vector loop and the byte loop both find it
+TEST(TokenizerTest, FindDelimiterAtEveryPosition)
+{
+	for (size_t delimiterPosition = 0; delimiterPosition < 48; ++delimiterPosition)
+	{
+		std::string text(48, 'x');
+		text[delimiterPosition] = '\t';
+		text[47] = (delimiterPosition == 47) ? '\t' : ';'; // a later delimiter of another kind is ignored
+		const char* found = graphite::Tokenizer::findDelimiter(text.data(), text.data() + text.size(), '\t');
+		EXPECT_EQ(delimiterPosition, (size_t)(found - text.data()));
+	}
+}
+
+TEST(TokenizerTest, FindDelimiterReturnsEndWithoutOne)
+{
+	for (size_t size = 0; size < 40; ++size)
+	{
+		std::string text(size, 'x');
+		EXPECT_EQ(text.data() + size, graphite::Tokenizer::findDelimiter(text.data(), text.data() + size, '\t'));
+	}
+	// a delimiter past end isn't found
+	std::string text = "abcdefghijklmnopqrstu\t";
+	EXPECT_EQ(text.data() + 21, graphite::Tokenizer::findDelimiter(text.data(), text.data() + 21, '\t'));
+}
+
+TEST(TokenizerTest, SplitKeepsEmptyFields)
+{
+	EXPECT_EQ(std::vector< std::string >({ "a", "bc", "", "d" }), splitToStrings("a\tbc\t\td", '\t'));
+	EXPECT_EQ(std::vector< std::string >({ "", "a", "" }), splitToStrings("\ta\t", '\t'));
+	EXPECT_EQ(std::vector< std::string >({ "abc" }), splitToStrings("abc", '\t'));
+	EXPECT_EQ(std::vector< std::string >({ "" }), splitToStrings("", '\t'));
+}
+
+TEST(TokenizerTest, SplitLongLine)
+{
+	std::vector< std::string > expectedFields;
+	std::string line;
+	for (size_t i = 0; i < 100; ++i)
+	{
+		expectedFields.emplace_back(std::string(i % 23, 'a' + (i % 26)));
+		line += ((i > 0) ? ":" : "") + expectedFields.back();
+	}
+	EXPECT_EQ(expectedFields, splitToStrings(line, ':'));
+}
+
+TEST(TokenizerTest, ParseUnsignedAcceptsOnlyDigitsThatFit)
+{
+	uint32_t value = 7;
+	EXPECT_TRUE(parseUnsignedString("0", value));
+	EXPECT_EQ(0, value);
+	EXPECT_TRUE(parseUnsignedString("123456", value));
+	EXPECT_EQ(123456, value);
+	EXPECT_TRUE(parseUnsignedString("4294967295", value));
+	EXPECT_EQ(4294967295u, value);
+
+	value = 7;
+	EXPECT_FALSE(parseUnsignedString("4294967296", value));
+	EXPECT_FALSE(parseUnsignedString("", value));
+	EXPECT_FALSE(parseUnsignedString("12a", value));
+	EXPECT_FALSE(parseUnsignedString("-1", value));
+	EXPECT_FALSE(parseUnsignedString(" 1", value));
+	EXPECT_EQ(7, value); // left alone when parsing fails
+
+	uint64_t largeValue = 0;
+	EXPECT_TRUE(parseUnsignedString("4294967296", largeValue));
+	EXPECT_EQ(4294967296ull, largeValue);
+	EXPECT_TRUE(parseUnsignedString("18446744073709551615", largeValue));
+	EXPECT_FALSE(parseUnsignedString("18446744073709551616", largeValue));
+
+	uint8_t smallValue = 0;
+	EXPECT_TRUE(parseUnsignedString("255", smallValue));
+	EXPECT_EQ(255, smallValue);
+	EXPECT_FALSE(parseUnsignedString("256", smallValue));
+}
+
+#endif //GRAPHITE_TESTS_TOKENIZER_HPP
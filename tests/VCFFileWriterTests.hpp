@@ -0,0 +1,169 @@
+#ifndef GRAPHITE_TESTS_VCFFILEWRITER_HPP
+#define GRAPHITE_TESTS_VCFFILEWRITER_HPP
+
+#include "core/vcf/VCFFileWriter.h"
+
+#include <htslib/bgzf.h>
+#include <htslib/tbx.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+#include <unistd.h>
+
+namespace
+{
+	struct TestRecord
+	{
+		std::string m_chrom;
+		uint32_t m_position;
+		std::string m_line;
+		uint64_t m_offset; // of the line's first byte in the uncompressed file
+	};
+
+	/*
+	 * Records on two chromosomes with INFO columns of different lengths so records start anywhere in a block,
+	 * there are enough of them to fill more than one of the writer's buffers.
+	 */
+	std::vector< TestRecord > writeTestRecords(const std::string& path, uint32_t compressionThreadCount)
+	{
+		std::vector< std::string > headerLines = { "##fileformat=VCFv4.1", "##INFO=<ID=PAD,Number=1,Type=String,Description=\"Padding\">", "#CHROM\tPOS\tID\tREF\tALT\tQUAL\tFILTER\tINFO" };
+		std::vector< TestRecord > testRecords;
+		graphite::VCFFileWriter vcfFileWriter(path, compressionThreadCount);
+		uint64_t offset = 0;
+		for (auto& headerLine : headerLines)
+		{
+			vcfFileWriter.writeLine(headerLine);
+			offset += headerLine.size() + 1;
+		}
+		for (std::string chrom : { "1", "2" })
+		{
+			for (uint32_t i = 0; i < 30000; ++i)
+			{
+				TestRecord testRecord;
+				testRecord.m_chrom = chrom;
+				testRecord.m_position = 1000 + (i * 10);
+				testRecord.m_line = chrom + "\t" + std::to_string(testRecord.m_position) + "\t.\tA\tC\t.\tPASS\tPAD=" + std::string(1 + (i % 97), 'x');
+				testRecord.m_offset = offset;
+				vcfFileWriter.writeLine(testRecord.m_line);
+				offset += testRecord.m_line.size() + 1;
+				testRecords.emplace_back(testRecord);
+			}
+		}
+		vcfFileWriter.close();
+		return testRecords;
+	}
+
+	std::vector< std::string > queryRecords(const std::string& path, const std::string& chrom, int begin, int end)
+	{
+		std::vector< std::string > lines;
+		tbx_t* tbxPtr = tbx_index_load(path.c_str());
+		htsFile* htsFilePtr = hts_open(path.c_str(), "r");
+		EXPECT_NE(nullptr, tbxPtr);
+		EXPECT_NE(nullptr, htsFilePtr);
+		if (tbxPtr == nullptr || htsFilePtr == nullptr)
+		{
+			return lines;
+		}
+		hts_itr_t* iteratorPtr = tbx_itr_queryi(tbxPtr, tbx_name2id(tbxPtr, chrom.c_str()), begin, end);
+		EXPECT_NE(nullptr, iteratorPtr);
+		kstring_t line = {0, 0, nullptr};
+		while (iteratorPtr != nullptr && tbx_itr_next(htsFilePtr, tbxPtr, iteratorPtr, &line) >= 0)
+		{
+			lines.emplace_back(line.s, line.l);
+		}
+		free(line.s);
+		tbx_itr_destroy(iteratorPtr);
+		hts_close(htsFilePtr);
+		tbx_destroy(tbxPtr);
+		return lines;
+	}
+
+	// the records whose one base REF lies in the zero based [begin, end)
+	std::vector< std::string > getExpectedRecords(const std::vector< TestRecord >& testRecords, const std::string& chrom, int begin, int end)
+	{
+		std::vector< std::string > lines;
+		for (auto& testRecord : testRecords)
+		{
+			int recordBegin = (int)testRecord.m_position - 1;
+			if (testRecord.m_chrom == chrom && begin <= recordBegin && recordBegin < end)
+			{
+				lines.emplace_back(testRecord.m_line);
+			}
+		}
+		return lines;
+	}
+}
+
+TEST(VCFFileWriterTest, BgzipOutputReadsBackLineForLine)
+{
+	char directoryTemplate[] = "/tmp/graphite_vcffilewriter_XXXXXX";
+	std::string directory = mkdtemp(directoryTemplate);
+	std::string path = directory + "/records.vcf.gz";
+	auto testRecords = writeTestRecords(path, 2);
+
+	BGZF* bgzfPtr = bgzf_open(path.c_str(), "r");
+	ASSERT_NE(nullptr, bgzfPtr);
+	EXPECT_EQ(1, bgzf_check_EOF(bgzfPtr));
+	std::vector< std::string > lines;
+	kstring_t line = {0, 0, nullptr};
+	while (bgzf_getline(bgzfPtr, '\n', &line) >= 0)
+	{
+		lines.emplace_back(line.s, line.l);
+	}
+	free(line.s);
+	bgzf_close(bgzfPtr);
+
+	ASSERT_EQ(3 + testRecords.size(), lines.size());
+	EXPECT_EQ("##fileformat=VCFv4.1", lines[0]);
+	for (size_t i = 0; i < testRecords.size(); ++i)
+	{
+		ASSERT_EQ(testRecords[i].m_line, lines[3 + i]);
+	}
+	system(("rm -rf " + directory).c_str());
+}
+
+TEST(VCFFileWriterTest, TabixQueriesReturnTheOverlappingRecords)
+{
+	char directoryTemplate[] = "/tmp/graphite_vcffilewriter_XXXXXX";
+	std::string directory = mkdtemp(directoryTemplate);
+	std::string path = directory + "/records.vcf.gz";
+	auto testRecords = writeTestRecords(path, 2);
+	ASSERT_EQ(0, access((path + ".tbi").c_str(), F_OK));
+
+	// the record holding the first block boundary starts in one block and ends in the next
+	const uint64_t blockSize = 0xff00;
+	auto crossingIter = std::find_if(testRecords.begin(), testRecords.end(), [blockSize](const TestRecord& testRecord) { return testRecord.m_offset + testRecord.m_line.size() + 1 > blockSize; });
+	ASSERT_NE(testRecords.end(), crossingIter);
+	ASSERT_LT(crossingIter->m_offset, blockSize);
+	int crossingBegin = (int)crossingIter->m_position - 1;
+
+	// the record where the writer's first 4MB buffer ends
+	const uint64_t bufferSize = 4 * 1024 * 1024;
+	auto bufferEndIter = std::find_if(testRecords.begin(), testRecords.end(), [bufferSize](const TestRecord& testRecord) { return testRecord.m_offset >= bufferSize; });
+	ASSERT_NE(testRecords.end(), bufferEndIter);
+	int bufferEndBegin = (int)bufferEndIter->m_position - 1;
+
+	struct Query { std::string m_chrom; int m_begin; int m_end; };
+	std::vector< Query > queries = {
+		{ crossingIter->m_chrom, crossingBegin - 25, crossingBegin + 25 },
+		{ crossingIter->m_chrom, crossingBegin, crossingBegin + 1 },
+		{ bufferEndIter->m_chrom, bufferEndBegin - 5000, bufferEndBegin + 5000 },
+		{ "1", 0, 999 }, // before the first record
+		{ "1", 0, 5000 },
+		{ "2", 150000, 160000 },
+		{ "2", 290000, 400000 }, // the end of the file
+	};
+	for (auto& query : queries)
+	{
+		auto expectedLines = getExpectedRecords(testRecords, query.m_chrom, query.m_begin, query.m_end);
+		auto lines = queryRecords(path, query.m_chrom, query.m_begin, query.m_end);
+		EXPECT_EQ(expectedLines, lines) << query.m_chrom << ":" << query.m_begin << "-" << query.m_end;
+	}
+	system(("rm -rf " + directory).c_str());
+}
+
+#endif //GRAPHITE_TESTS_VCFFILEWRITER_HPP
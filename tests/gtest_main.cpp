@@ -1,17 +1,13 @@
 #include "gtest/gtest.h"
 
 #include "IntegrationTests.hpp"
-#include "VCFFileTests.hpp"
-#include "BamAlignmentReaderTests.hpp"
 #include "RegionTests.hpp"
-#include "FileTests.hpp"
-#include "VCFFileTests.hpp"
-#include "GSSWTests.hpp"
-#include "GSSWGraphTests.hpp"
-#include "AlleleTests.hpp"
-#include "VariantsTest.hpp"
-#include "CompoundVariantTests.hpp"
-#include "FastaReferenceTests.hpp"
+#include "AtomicBitmapTests.hpp"
+#include "VCFFileWriterTests.hpp"
+#include "GraphiteRunTests.hpp"
+#include "TokenizerTests.hpp"
+#include "LineReaderTests.hpp"
+#include "ShardProcessorTests.hpp"
 
 GTEST_API_ int main(int argc, char** argv)
 {
@@ -1,17 +1,19 @@
 //#include <Python.h>
 #include "core/util/Params.h"
 #include "core/region/Region.h"
-#include "core/reference/FastaReference.h"
-#include "core/vcf/VCFReader.h"
-#include "core/vcf/VCFWriter.h"
-#include "core/bam/BamReader.h"
-#include "core/graph/GraphProcessor.h"
+#include "core/shard/ShardProcessor.h"
+#include "core/distributed/DistributedCoordinator.h"
+#include "core/distributed/DistributedWorker.h"
 
+#include <algorithm>
 #include <string>
 #include <iostream>
 
 int main(int argc, char** argv)
 {
+	// keep the original arguments, workers are launched with the same ones
+	std::vector< std::string > arguments(argv, argv + argc);
+
 	// get all param properties
 	graphite::Params params;
 	params.parseGSSW(argc, argv);
@@ -31,37 +33,36 @@ int main(int argc, char** argv)
 	auto gapExtensionValue = params.getGapExtensionValue();
 	auto includeDuplicates = params.getIncludeDuplicates();
 	auto outputVisualizationFiles = params.outputVisualizationFiles();
+	auto threadCount = params.getThreadCount();
+	auto shardCount = params.getShardCount();
+	auto workerCount = params.getWorkerCount();
+	auto prefetch = params.getPrefetch();
+	auto sweep = params.getSweep();
+	auto decompressionThreadCount = params.getDecompressionThreadCount();
+	auto maxDepth = params.getMaxDepth();
+	auto bgzipThreadCount = params.getBgzipThreadCount();
 
-    // create reference reader
-	auto fastaReferencePtr = std::make_shared< graphite::FastaReference >(fastaPath);
-
-	// track samples from bams
-	std::vector< graphite::Sample::SharedPtr > bamSamplePtrs;
-
-	// create bam readers
-	std::vector< graphite::BamReader::SharedPtr > bamReaderPtrs;
-	for (auto bamPath : bamPaths)
+	// create shard processor, every shard creates its own reference, bam and vcf readers and writers
+	// call process on processor
+	auto shardProcessorPtr = std::make_shared< graphite::ShardProcessor >(fastaPath, bamPaths, vcfPaths, outputDirectory, paramRegionPtr, matchValue, misMatchValue, gapOpenValue, gapExtensionValue, outputVisualizationFiles, prefetch, sweep, decompressionThreadCount, maxDepth, bgzipThreadCount);
+	if (params.isWorker())
 	{
-		auto bamReaderPtr = std::make_shared< graphite::BamReader >(bamPath);
-        auto samplePtrs = bamReaderPtr->getSamplePtrs();
-		bamSamplePtrs.insert(bamSamplePtrs.begin(), samplePtrs.begin(), samplePtrs.end());
-		bamReaderPtrs.emplace_back(bamReaderPtr);
+		// the threads are split between the coordinator's workers
+		uint32_t workerThreadCount = std::max< uint32_t >(1, threadCount / std::max< uint32_t >(1, workerCount));
+		auto distributedWorkerPtr = std::make_shared< graphite::DistributedWorker >(shardProcessorPtr, graphite::DistributedWorker::READ_FD, graphite::DistributedWorker::WRITE_FD, workerThreadCount);
+		distributedWorkerPtr->process();
 	}
-
-	// create VCF readers
-	// create VCF writers
-	std::vector< graphite::VCFReader::SharedPtr > vcfReaderPtrs;
-	for (auto vcfPath : vcfPaths)
+	else if (workerCount > 0)
 	{
-		auto vcfWriterPtr = std::make_shared< graphite::VCFWriter >(vcfPath, bamSamplePtrs, outputDirectory);
-		auto vcfReaderPtr = std::make_shared< graphite::VCFReader >(vcfPath, bamSamplePtrs, paramRegionPtr, vcfWriterPtr);
-		vcfReaderPtrs.emplace_back(vcfReaderPtr);
+		// without an explicit shard count every worker gets a few units so faster workers can pick up more
+		uint32_t unitCount = (shardCount > 1) ? shardCount : workerCount * 4;
+		auto distributedCoordinatorPtr = std::make_shared< graphite::DistributedCoordinator >(shardProcessorPtr, arguments, workerCount, 3);
+		distributedCoordinatorPtr->process(unitCount);
+	}
+	else
+	{
+		shardProcessorPtr->process(shardCount, threadCount);
 	}
-
-	// create graph processor
-	// call process on processor
-	auto graphProcessorPtr = std::make_shared< graphite::GraphProcessor >(fastaReferencePtr, bamReaderPtrs, vcfReaderPtrs, matchValue, misMatchValue, gapOpenValue, gapExtensionValue, outputVisualizationFiles);
-	graphProcessorPtr->processVariants();
 
 	return 0;
 }
@@ -0,0 +1,73 @@
+#include "core/util/LineReader.h"
+#include "core/util/gzstream.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+
+/*
+ * Reads every line of a vcf (or any text file, gzipped or not) with graphite's LineReader and with
+ * std::getline and prints the line throughput of both. A plain file larger than memory is read from
+ * disk by both passes, compare them with `dd if=<file> of=/dev/null bs=4M` to see the disk's ceiling.
+ */
+int main(int argc, char** argv)
+{
+	if (argc != 2)
+	{
+		std::cout << "usage: vcf_line_benchmark <file.vcf[.gz]>" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::string path = argv[1];
+
+	auto printThroughput = [](const std::string& name, uint64_t lineCount, uint64_t byteCount, std::chrono::duration< double > elapsed)
+	{
+		double gigabytesPerSecond = (elapsed.count() > 0) ? (byteCount / 1e9) / elapsed.count() : 0;
+		std::cout << name << ": " << lineCount << " lines, " << byteCount << " bytes in " << elapsed.count() << "s, " << gigabytesPerSecond << " GB/s" << std::endl;
+	};
+
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		graphite::LineReader lineReader(path);
+		if (!lineReader.isOpen())
+		{
+			std::cout << "unable to open " << path << std::endl;
+			return EXIT_FAILURE;
+		}
+		graphite::StringView line;
+		uint64_t lineCount = 0;
+		uint64_t byteCount = 0;
+		while (lineReader.getNextLine(line))
+		{
+			++lineCount;
+			byteCount += line.size() + 1;
+		}
+		printThroughput("LineReader", lineCount, byteCount, std::chrono::steady_clock::now() - startTime);
+	}
+
+	{
+		auto startTime = std::chrono::steady_clock::now();
+		std::shared_ptr< std::istream > fileStreamPtr;
+		if (path.substr(path.find_last_of(".") + 1) == "gz")
+		{
+			auto igzstreamPtr = std::make_shared< igzstream >();
+			igzstreamPtr->open(path.c_str());
+			fileStreamPtr = igzstreamPtr;
+		}
+		else
+		{
+			fileStreamPtr = std::make_shared< std::ifstream >(path, std::fstream::in);
+		}
+		std::string line;
+		uint64_t lineCount = 0;
+		uint64_t byteCount = 0;
+		while (std::getline(*fileStreamPtr, line))
+		{
+			++lineCount;
+			byteCount += line.size() + 1;
+		}
+		printThroughput("std::getline", lineCount, byteCount, std::chrono::steady_clock::now() - startTime);
+	}
+	return EXIT_SUCCESS;
+}